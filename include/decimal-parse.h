@@ -0,0 +1,65 @@
+#ifndef DECIMAL_PARSE_H
+#define DECIMAL_PARSE_H
+#include <cstddef>
+#include <cstdint>
+#include <system_error>
+#include <boost/cstdfloat.hpp>
+
+/**
+ * A decimal number scanned once and then rounded to any of the float types,
+ * without exceptions.
+ *
+ * parse accepts what boost::lexical_cast accepts for floats: an optional
+ * sign, then digits with an optional decimal point and exponent, or "inf",
+ * "infinity", or "nan" with an optional "(chars)", in any case. Nothing may
+ * come before or after.
+ *
+ * to rounds half to even. Most values take Clinger's exact fast path or the
+ * Eisel-Lemire algorithm; the rest, and every float80, are divided out with
+ * big integers. The value refers to the parsed text, which must outlive it.
+ */
+class decimal_value
+{
+public:
+    decimal_value();
+
+    // std::errc() if all of [first, last) is a number, otherwise
+    // std::errc::invalid_argument.
+    std::errc parse(char const* first, char const* last);
+
+    // Round the parsed number to result. If it's too large for the type,
+    // result is an infinity and the return is std::errc::result_out_of_range.
+    // Too small rounds to zero, as it does for lexical_cast.
+#ifdef BOOST_FLOAT80_C
+    std::errc to(boost::float80_t& result) const;
+#endif
+#ifdef BOOST_FLOAT64_C
+    std::errc to(boost::float64_t& result) const;
+#endif
+#ifdef BOOST_FLOAT32_C
+    std::errc to(boost::float32_t& result) const;
+#endif
+private:
+    template <typename Float>
+    std::errc convert(Float& result) const;
+
+    template <typename Float>
+    std::errc convert_exactly(Float& result) const;
+
+    enum class category : unsigned char { finite, infinity, nan };
+    category m_category;
+    bool m_negative;
+    // Set when digits past the first 19 significant ones aren't all zero
+    bool m_truncated;
+    // Up to 19 significant digits, and the power of ten that scales them
+    std::uint64_t m_digits;
+    std::int64_t m_exponent;
+    // Every digit from the first nonzero one, maybe with a decimal point
+    // among them, for when the leading digits don't settle the rounding
+    char const* m_first;
+    char const* m_last;
+    std::size_t m_significant;
+    std::int64_t m_full_exponent;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef EXACT_CACHE_H
+#define EXACT_CACHE_H
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include "exact-float.h"
+
+// How an exact_cache has fared so far
+struct exact_cache_stats
+{
+    std::uint64_t hits;
+    std::uint64_t misses;
+    // Expansions held now
+    size_t entries;
+};
+
+/**
+ * Finished exact expansions of recently seen values, for input that repeats
+ * the same values many times. Entries are keyed on a value's kind, sign,
+ * exponent, and mantissa fields, and all use the one format the cache was
+ * made with. At most capacity entries are kept. Large caches are split into
+ * up to 64 shards, each with its own lock, and each drops its least recently
+ * used entry to make room. Any number of threads may share a cache, and they
+ * only wait on each other when their values land in the same shard.
+ */
+class exact_cache
+{
+public:
+    explicit exact_cache(size_t capacity, exact_format const& format = exact_format());
+    ~exact_cache();
+
+    exact_cache(exact_cache const&) = delete;
+    exact_cache& operator=(exact_cache const&) = delete;
+
+    // exact_to_chars with the cache's format, copying an earlier result when
+    // there is one.
+    exact_to_chars_result to_chars(char* first, char* last, FloatInfo const& info);
+
+    // Write the expansion to os as it is, without the stream's padding or
+    // flags.
+    void write(std::ostream& os, FloatInfo const& info);
+
+    exact_format const& format() const {
+        return m_format;
+    }
+
+    exact_cache_stats stats() const;
+private:
+    struct shard;
+
+    exact_format const m_format;
+    size_t const m_shard_count;
+    std::unique_ptr<shard[]> m_shards;
+};
+
+#endif
@@ -1,23 +1,164 @@
 #ifndef ANALYZE_FLOAT_H
 #define ANALYZE_FLOAT_H
 #undef _GLIBCXX_DEBUG
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <iterator>
 #include <limits>
 #include <string>
-#include <map>
+#include <system_error>
+#include <vector>
 #include <bitset>
 #include <typeindex>
+#include <type_traits>
 #include <boost/format.hpp>
+#include <boost/predef/other/endian.h>
 #include <boost/cstdfloat.hpp>
 #include <boost/multiprecision/cpp_int.hpp>
 
 namespace mp = boost::multiprecision;
 
-enum float_type { unknown, normal, zero, denormal, indefinite, infinity, quiet_nan, signaling_nan };
+enum float_type: unsigned char { unknown, normal, zero, denormal, indefinite, infinity, quiet_nan, signaling_nan };
 
 std::ostream& operator<<(std::ostream&, float_type);
 
-struct float_traits
+// Result of exact_to_chars, in the manner of std::to_chars. On success, ptr
+// is one past the last character written. When the buffer is too small, ptr
+// is the end of the buffer and ec is std::errc::value_too_large.
+struct exact_to_chars_result
+{
+    char* ptr;
+    std::errc ec;
+};
+
+// exact writes every digit of the value. fixed and scientific round it, half
+// to even, to exact_format::precision digits after the decimal point, as the
+// iostream flags of the same names do.
+enum class exact_notation { exact, fixed, scientific };
+
+// Punctuation and sign options for exact_to_chars. The defaults give plain
+// digits with a '.' and a sign only on negative numbers; operator<< fills
+// these in from the stream's flags and locale.
+struct exact_format
+{
+    char decimal_point;
+    char thousands_sep;
+    std::string grouping;
+    bool showpos;
+    bool showpoint;
+    bool uppercase;
+    exact_notation notation;
+    int precision;
+
+    exact_format():
+        decimal_point('.'), thousands_sep(','), grouping(), showpos(false), showpoint(false), uppercase(false),
+        notation(exact_notation::exact), precision(6)
+    { }
+
+    // Round to the given number of digits after the decimal point. For N
+    // significant digits, use scientific with N - 1.
+    exact_format(exact_notation notation, int precision):
+        exact_format()
+    {
+        this->notation = notation;
+        this->precision = precision;
+    }
+
+    // The options operator<< uses for this stream
+    explicit exact_format(std::ostream& os);
+};
+
+// The float types this library handles, for code that must pick one at run
+// time. Each names a row of float_descriptors.
+enum class float_kind : unsigned char {
+#ifdef BOOST_FLOAT80_C
+    float80,
+#endif
+#ifdef BOOST_FLOAT64_C
+    float64,
+#endif
+#ifdef BOOST_FLOAT32_C
+    float32,
+#endif
+};
+
+// How many float_kind values there are
+unsigned const float_kinds = 0
+#ifdef BOOST_FLOAT80_C
+    + 1
+#endif
+#ifdef BOOST_FLOAT64_C
+    + 1
+#endif
+#ifdef BOOST_FLOAT32_C
+    + 1
+#endif
+    ;
+
+// Layout of a binary float type, known at compile time
+template <typename Float>
+struct float_traits;
+
+template <typename Float, float_kind Kind, unsigned Bits, bool ImpliedOne>
+struct basic_float_traits
+{
+    static constexpr float_kind kind = Kind;
+    static constexpr unsigned bits = Bits;
+    static constexpr unsigned digits = std::numeric_limits<Float>::digits;
+    static constexpr bool implied_one = ImpliedOne;
+    static constexpr unsigned max_exponent = std::numeric_limits<Float>::max_exponent;
+    static constexpr unsigned mantissa_bits = digits - implied_one;
+    static constexpr unsigned exponent_bits = bits - 1 - mantissa_bits;
+    static constexpr unsigned exponent_bias = max_exponent - 1;
+    static constexpr std::uint64_t mantissa_mask = ~std::uint64_t(0) >> (64 - mantissa_bits);
+    static constexpr unsigned exponent_mask = (1u << exponent_bits) - 1;
+};
+
+template <typename Float, float_kind Kind, unsigned Bits, bool ImpliedOne>
+constexpr float_kind basic_float_traits<Float, Kind, Bits, ImpliedOne>::kind;
+template <typename Float, float_kind Kind, unsigned Bits, bool ImpliedOne>
+constexpr unsigned basic_float_traits<Float, Kind, Bits, ImpliedOne>::bits;
+template <typename Float, float_kind Kind, unsigned Bits, bool ImpliedOne>
+constexpr unsigned basic_float_traits<Float, Kind, Bits, ImpliedOne>::digits;
+template <typename Float, float_kind Kind, unsigned Bits, bool ImpliedOne>
+constexpr bool basic_float_traits<Float, Kind, Bits, ImpliedOne>::implied_one;
+template <typename Float, float_kind Kind, unsigned Bits, bool ImpliedOne>
+constexpr unsigned basic_float_traits<Float, Kind, Bits, ImpliedOne>::max_exponent;
+template <typename Float, float_kind Kind, unsigned Bits, bool ImpliedOne>
+constexpr unsigned basic_float_traits<Float, Kind, Bits, ImpliedOne>::mantissa_bits;
+template <typename Float, float_kind Kind, unsigned Bits, bool ImpliedOne>
+constexpr unsigned basic_float_traits<Float, Kind, Bits, ImpliedOne>::exponent_bits;
+template <typename Float, float_kind Kind, unsigned Bits, bool ImpliedOne>
+constexpr unsigned basic_float_traits<Float, Kind, Bits, ImpliedOne>::exponent_bias;
+template <typename Float, float_kind Kind, unsigned Bits, bool ImpliedOne>
+constexpr std::uint64_t basic_float_traits<Float, Kind, Bits, ImpliedOne>::mantissa_mask;
+template <typename Float, float_kind Kind, unsigned Bits, bool ImpliedOne>
+constexpr unsigned basic_float_traits<Float, Kind, Bits, ImpliedOne>::exponent_mask;
+
+#ifdef BOOST_FLOAT80_C
+// The x87 format stores its integer bit.
+template <>
+struct float_traits<boost::float80_t>: basic_float_traits<boost::float80_t, float_kind::float80, 80, false>
+{ };
+#endif
+
+#ifdef BOOST_FLOAT64_C
+template <>
+struct float_traits<boost::float64_t>: basic_float_traits<boost::float64_t, float_kind::float64, 64, true>
+{ };
+#endif
+
+#ifdef BOOST_FLOAT32_C
+template <>
+struct float_traits<boost::float32_t>: basic_float_traits<boost::float32_t, float_kind::float32, 32, true>
+{ };
+#endif
+
+// The same facts as float_traits, for code that handles whichever kind of
+// float it is given
+struct float_descriptor
 {
     unsigned bits;
     unsigned digits;
@@ -25,6 +166,9 @@ struct float_traits
     unsigned max_exponent;
     char const* article;
     char const* name;
+    // Writes mantissa * 2^exponent using an integer type wide enough for the
+    // exact expansion of every value of this float type.
+    exact_to_chars_result (*write_decimal)(char*, char*, mp::cpp_int const&, int, bool, exact_format const&);
 
     unsigned mantissa_bits() const {
         return digits - implied_one;
@@ -48,62 +192,382 @@ struct float_traits
     }
 };
 
-extern std::map<std::type_index, float_traits> const float_trait_map;
+// Indexed by float_kind. The table is constant-initialized, so it's usable
+// from other static initializers.
+extern float_descriptor const float_descriptors[];
+
+inline
+float_descriptor const&
+describe(float_kind const kind)
+{
+    return float_descriptors[static_cast<unsigned>(kind)];
+}
+
+template <typename Float>
+float_descriptor const&
+describe()
+{
+    return describe(float_traits<Float>::kind);
+}
+
+// For callers that only have a std::type_index; throws std::out_of_range for
+// a type this library doesn't handle.
+float_kind
+kind_of(std::type_index type);
+
+namespace detail
+{
+
+template <unsigned Bits>
+struct float_word { };
+
+template <>
+struct float_word<32> { using type = std::uint32_t; };
+
+template <>
+struct float_word<64> { using type = std::uint64_t; };
+
+}
+
+// Store value's bits in rec, reusing its storage. Floats share the byte order
+// of integers of the same size, so the 32- and 64-bit types are copied into a
+// native word.
+template <typename Float>
+typename std::enable_if<float_traits<Float>::bits <= 64>::type
+to_float_rec(Float const value, mp::cpp_int& rec)
+{
+    typename detail::float_word<float_traits<Float>::bits>::type word;
+    static_assert(sizeof word == sizeof value, "float and word sizes differ");
+    std::memcpy(&word, &value, sizeof word);
+    rec = word;
+}
+
+// Wider types put their representation first, ahead of any padding, in the
+// machine's byte order.
+template <typename Float>
+typename std::enable_if<(float_traits<Float>::bits > 64)>::type
+to_float_rec(Float const value, mp::cpp_int& rec)
+{
+    unsigned char bytes[sizeof value];
+    std::memcpy(bytes, &value, sizeof value);
+    // import_bits keeps the existing sign.
+    rec = 0;
+    mp::import_bits(rec, bytes, bytes + float_traits<Float>::bits / CHAR_BIT, CHAR_BIT, BOOST_ENDIAN_BIG_BYTE != 0);
+}
 
 template <typename Float>
 mp::cpp_int
 to_float_rec(Float const value)
 {
-    float_traits const& traits = float_trait_map.at(typeid(Float));
     mp::cpp_int result;
-    auto const v = reinterpret_cast<unsigned char const*>(&value);
-    // TODO: Handle endian variation
-    for (auto i = 0u; i < traits.bits; ++i)
-        if (v[i / CHAR_BIT] & (1u << (i % CHAR_BIT)))
-            mp::bit_set(result, i);
+    to_float_rec(value, result);
     return result;
 }
 
+namespace detail
+{
+
+// The exponent and mantissa fields of value, read straight from its bytes
+template <typename Float>
+typename std::enable_if<float_traits<Float>::bits <= 64>::type
+split_fields(Float const value, std::uint32_t& exponent, std::uint64_t& mantissa)
+{
+    using traits = float_traits<Float>;
+    typename float_word<traits::bits>::type word;
+    std::memcpy(&word, &value, sizeof word);
+    exponent = (word >> traits::mantissa_bits) & traits::exponent_mask;
+    mantissa = word & traits::mantissa_mask;
+}
+
+// The 64-bit mantissa takes the low eight bytes of the representation and
+// the sign and exponent the next two.
+template <typename Float>
+typename std::enable_if<(float_traits<Float>::bits > 64)>::type
+split_fields(Float const value, std::uint32_t& exponent, std::uint64_t& mantissa)
+{
+    using traits = float_traits<Float>;
+    static_assert(traits::mantissa_bits == 64, "only the x87 layout is wider than 64 bits");
+    unsigned char bytes[sizeof value];
+    std::memcpy(bytes, &value, sizeof value);
+    auto const byte = [&bytes](unsigned const i) -> std::uint64_t {
+        return bytes[BOOST_ENDIAN_BIG_BYTE ? traits::bits / CHAR_BIT - 1 - i : i];
+    };
+    mantissa = 0;
+    for (unsigned i = 0; i < 8; ++i)
+        mantissa |= byte(i) << (CHAR_BIT * i);
+    exponent = (byte(8) | byte(9) << CHAR_BIT) & traits::exponent_mask;
+}
+
+}
+
+float_type
+get_float_type(std::uint32_t exponent, std::uint64_t mantissa, float_kind kind);
+
 float_type
 get_float_type(mp::cpp_int exponent, mp::cpp_int mantissa, std::type_index type);
 
+struct FloatInfo;
+
+exact_to_chars_result
+exact_to_chars(char* first, char* last, FloatInfo const& info, exact_format const& format = exact_format());
+
+size_t
+exact_length(FloatInfo const& info, exact_format const& format = exact_format());
+
+// The fields of a float in 16 bytes. It's trivially copyable and packs
+// densely in arrays; the wide integers formatting needs are built only when
+// a value is written.
 struct FloatInfo
 {
-private:
-    float_traits const& traits;
-    mp::cpp_int rec;
-public:
     bool negative;
-    mp::cpp_int exponent;
-    mp::cpp_int mantissa;
+    float_kind kind;
     float_type number_type;
+    // The stored, biased exponent field
+    std::int32_t exponent;
+    // The stored mantissa field, without any implied bit
+    std::uint64_t mantissa;
+
+    // Positive zero of the first kind, so arrays can be sized before filling
+    FloatInfo():
+        negative(false), kind(), number_type(zero), exponent(0), mantissa(0)
+    { }
 
     template <typename Float>
     explicit FloatInfo(Float const value):
-        traits(float_trait_map.at(typeid(Float))),
-        rec(to_float_rec(value)),
-        negative(value < 0),
-        exponent(traits.get_exponent(rec)),
-        mantissa(traits.get_mantissa(rec)),
-        number_type(get_float_type(exponent, mantissa, typeid(Float)))
+        negative(std::signbit(value)), kind(float_traits<Float>::kind), number_type(), exponent(), mantissa()
+    {
+        std::uint32_t biased;
+        detail::split_fields(value, biased, mantissa);
+        exponent = biased;
+        number_type = get_float_type(biased, mantissa, kind);
+    }
+
+    FloatInfo(bool negative, mp::cpp_int const& exponent, mp::cpp_int const& mantissa, float_type number_type,
+              float_kind kind):
+        negative(negative), kind(kind), number_type(number_type),
+        exponent(exponent.convert_to<std::int32_t>()), mantissa(mantissa.convert_to<std::uint64_t>())
     { }
 
-    FloatInfo(bool negative, mp::cpp_int exponent, mp::cpp_int mantissa, float_type number_type, std::type_index type):
-        traits(float_trait_map.at(type)),
-        rec(), negative(negative), exponent(exponent), mantissa(mantissa), number_type(number_type)
+    FloatInfo(bool negative, mp::cpp_int const& exponent, mp::cpp_int const& mantissa, float_type number_type,
+              std::type_index type):
+        FloatInfo(negative, exponent, mantissa, number_type, kind_of(type))
     { }
 
     bool operator==(FloatInfo const& other) const;
 
+    // Full mantissa and binary exponent of a finite value
+    void decompose(mp::cpp_int& value, int& bin_exp) const;
+
     friend std::ostream& operator<<(std::ostream& os, FloatInfo const& info);
+    friend exact_to_chars_result exact_to_chars(char* first, char* last, FloatInfo const& info, exact_format const& format);
+    friend size_t exact_length(FloatInfo const& info, exact_format const& format);
+    friend class exact_digits;
+    friend struct batch_converter;
+private:
+    // exact_to_chars and exact_length, with a caller's integer for scratch
+    exact_to_chars_result write(char* first, char* last, exact_format const& format, mp::cpp_int& value) const;
+    size_t length(exact_format const& format, mp::cpp_int& value) const;
 };
 
+static_assert(std::is_trivially_copyable<FloatInfo>::value, "FloatInfo should copy as plain bytes");
+static_assert(sizeof(FloatInfo) == 16, "FloatInfo should pack into 16 bytes");
+
 template <typename Float>
 FloatInfo exact(Float f)
 {
     return FloatInfo(f);
 }
 
+// Write the exact decimal expansion of value into [first, last). Single and
+// Double values never allocate.
+template <typename Float>
+exact_to_chars_result
+exact_to_chars(char* first, char* last, Float const value, exact_format const& format = exact_format())
+{
+    return exact_to_chars(first, last, FloatInfo(value), format);
+}
+
+// The number of characters exact_to_chars will write for value, computed from
+// the exponent and mantissa without converting. A stream also pads to its
+// width; exact_format(os) gives the rest of what operator<< uses.
+template <typename Float>
+size_t
+exact_length(Float const value, exact_format const& format = exact_format())
+{
+    return exact_length(FloatInfo(value), format);
+}
+
+/**
+ * Produces the characters exact_to_chars would write, a chunk at a time,
+ * without building the whole expansion first. Only the part of the value not
+ * yet written is kept: the whole part is divided down one chunk at a time, and
+ * the fraction is multiplied up by 10^16 with its integer part removed. A
+ * consumer can stop at any point.
+ *
+ *     for (char c: exact_digits(value)) ...
+ */
+class exact_digits
+{
+public:
+    class iterator;
+
+    explicit exact_digits(FloatInfo const& info);
+
+    template <typename Float>
+    explicit exact_digits(Float const value):
+        exact_digits(FloatInfo(value))
+    { }
+
+    // Point [first, last) at the next run of characters. Returns false once
+    // the expansion is finished.
+    bool next(char const*& first, char const*& last);
+
+    iterator begin();
+    iterator end();
+private:
+    enum class stage { sign, whole, point, fraction, done };
+    stage m_stage;
+    bool m_negative;
+    // Remaining whole part, or the fraction's numerator over 2^m_fraction_bits
+    mp::cpp_int m_value;
+    // 10^(16 * n) for the whole chunk after this one
+    mp::cpp_int m_scale;
+    size_t m_whole_digits;
+    unsigned m_fraction_bits;
+    size_t m_fraction_digits;
+    char m_chunk[32];
+};
+
+class exact_digits::iterator
+{
+public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = char;
+    using difference_type = std::ptrdiff_t;
+    using pointer = char const*;
+    using reference = char const&;
+
+    iterator():
+        m_source(nullptr), m_position(nullptr), m_end(nullptr)
+    { }
+
+    reference operator*() const { return *m_position; }
+
+    iterator& operator++() {
+        if (++m_position == m_end && !m_source->next(m_position, m_end))
+            *this = iterator();
+        return *this;
+    }
+
+    iterator operator++(int) {
+        iterator const result = *this;
+        ++*this;
+        return result;
+    }
+
+    bool operator==(iterator const& other) const { return m_position == other.m_position; }
+    bool operator!=(iterator const& other) const { return !(*this == other); }
+private:
+    friend class exact_digits;
+    iterator(exact_digits* source, char const* position, char const* end):
+        m_source(source), m_position(position), m_end(end)
+    { }
+
+    exact_digits* m_source;
+    char const* m_position;
+    char const* m_end;
+};
+
+// Text for many values, end to end in one buffer. Value i is written at
+// [offsets[i], offsets[i + 1]) in text.
+struct exact_batch_result
+{
+    std::string text;
+    std::vector<size_t> offsets;
+
+    size_t size() const {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+
+    std::string operator[](size_t const i) const {
+        return text.substr(offsets[i], offsets[i + 1] - offsets[i]);
+    }
+};
+
+// Convert count values into result, replacing what it held but reusing its
+// storage. One set of scratch integers serves every value, so converting
+// into the same result again allocates little or nothing.
+#ifdef BOOST_FLOAT80_C
+void exact_batch(boost::float80_t const* values, size_t count, exact_batch_result& result,
+                 exact_format const& format = exact_format());
+#endif
+#ifdef BOOST_FLOAT64_C
+void exact_batch(boost::float64_t const* values, size_t count, exact_batch_result& result,
+                 exact_format const& format = exact_format());
+#endif
+#ifdef BOOST_FLOAT32_C
+void exact_batch(boost::float32_t const* values, size_t count, exact_batch_result& result,
+                 exact_format const& format = exact_format());
+#endif
+
+template <typename Float>
+exact_batch_result
+exact_batch(Float const* values, size_t const count, exact_format const& format = exact_format())
+{
+    exact_batch_result result;
+    exact_batch(values, count, result, format);
+    return result;
+}
+
+// Any contiguous container of floats, such as std::vector or std::array
+template <typename Container>
+auto
+exact_batch(Container const& values, exact_format const& format = exact_format())
+    -> decltype(exact_batch(values.data(), values.size(), format))
+{
+    return exact_batch(values.data(), values.size(), format);
+}
+
+// The parts of a conversion that exact_stats times separately
+enum class exact_stage : unsigned char {
+    format,     // reading the stream's flags and locale
+    length,     // sizing the output
+    decompose,  // splitting the float into mantissa and exponent
+    normalize,  // turning mantissa * 2^exp into a whole number * 10^exp
+    digits,     // dividing out and writing decimal digits
+    grouping,   // inserting thousands separators
+    rounding,   // fixed and scientific notation
+    output,     // padding and writing to the stream
+};
+
+unsigned const exact_stages = static_cast<unsigned>(exact_stage::output) + 1;
+
+std::ostream& operator<<(std::ostream&, exact_stage);
+
+// Process-wide conversion counters. They only change while enabled with
+// enable_exact_stats, and otherwise cost each conversion a flag check.
+struct exact_stats
+{
+    // Values converted, by float_kind and float_type
+    std::uint64_t conversions[float_kinds][signaling_nan + 1];
+    // Nanoseconds spent in each exact_stage, across all threads
+    std::uint64_t stage_ns[exact_stages];
+    // Most limbs any conversion's whole-number integer needed
+    std::uint64_t peak_limbs;
+    // Characters of converted text, before padding
+    std::uint64_t output_bytes;
+};
+
+void
+enable_exact_stats(bool enable);
+
+// A copy of the counters so far
+exact_stats
+get_exact_stats();
+
+void
+reset_exact_stats();
+
 void
 FloatingBinPointToDecStr(std::ostream& os, mp::cpp_int Value, int ValBinExp, bool negative);
 
@@ -0,0 +1,46 @@
+#ifndef FLOAT_CLASSIFY_H
+#define FLOAT_CLASSIFY_H
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <boost/cstdfloat.hpp>
+#include "exact-float.h"
+
+// The fields and classes of an array of floats, one column per field, for
+// scanning large arrays without a FloatInfo per element.
+struct float_columns
+{
+    // Sign bits, so negative zeros and NaNs count as negative
+    std::vector<unsigned char> negative;
+    // Biased exponent fields
+    std::vector<std::uint32_t> exponent;
+    // Stored mantissa fields, without any implied bit
+    std::vector<std::uint64_t> mantissa;
+    // What get_float_type reports for each value
+    std::vector<float_type> type;
+    // How many values have each float_type
+    typedef std::array<size_t, signaling_nan + 1> histogram_type;
+    histogram_type histogram;
+};
+
+// Instruction sets classify_floats can use, in order of preference
+enum class simd_level { scalar, sse2, avx2 };
+
+// The best level this processor supports
+simd_level
+supported_simd_level();
+
+// Fill columns for count values, reusing their storage. The level defaults to
+// the best one available; a level the processor lacks is lowered to one it
+// has.
+#ifdef BOOST_FLOAT64_C
+void classify_floats(boost::float64_t const* values, size_t count, float_columns& columns,
+                     simd_level level = supported_simd_level());
+#endif
+#ifdef BOOST_FLOAT32_C
+void classify_floats(boost::float32_t const* values, size_t count, float_columns& columns,
+                     simd_level level = supported_simd_level());
+#endif
+
+#endif
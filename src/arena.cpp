@@ -0,0 +1,154 @@
+#include "config.h"
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include "arena.h"
+
+namespace {
+
+// Every allocation starts on this boundary.
+size_t const alignment = alignof(std::max_align_t);
+// The first block, and the least any later block grows by
+size_t const minimum_block = 64 * 1024;
+
+size_t
+aligned(size_t const bytes)
+{
+    return (bytes + alignment - 1) / alignment * alignment;
+}
+
+// The calling thread's arena while it exists. Trivially destructible, so
+// unlike the arena it stays readable until the thread ends, which for the
+// main thread is after every static is destroyed.
+thread_local arena* current = nullptr;
+
+}
+
+// Holds a thread's arena and says when it's gone.
+struct arena::owner
+{
+    arena instance;
+
+    owner() {
+        current = &instance;
+    }
+
+    ~owner() {
+        current = nullptr;
+    }
+};
+
+arena::arena():
+    m_top(0), m_filled(0), m_depth(0), m_heap(false)
+{ }
+
+arena&
+arena::local()
+{
+    static thread_local owner o;
+    return o.instance;
+}
+
+void*
+arena::allocate(size_t bytes)
+{
+    if (m_depth == 0 || m_heap)
+        return ::operator new(bytes);
+    bytes = aligned(bytes);
+    if (m_blocks.empty() || m_blocks.back().size - m_top < bytes)
+        return grow(bytes);
+    void* const result = m_blocks.back().data.get() + m_top;
+    m_top += bytes;
+    return result;
+}
+
+void
+arena::deallocate(void* const p, size_t const bytes)
+{
+    if (!owns(p)) {
+        ::operator delete(p);
+        return;
+    }
+    // Only the most recent allocation can be taken back; a value that
+    // grows a few times in a row reuses its own space that way.
+    char* const top = m_blocks.back().data.get() + m_top;
+    if (static_cast<char*>(p) + aligned(bytes) == top)
+        m_top -= aligned(bytes);
+}
+
+void
+arena::deallocate_local(void* const p, size_t const bytes)
+{
+    // Nothing can come from an arena that was never made.
+    if (arena* const a = current)
+        a->deallocate(p, bytes);
+    else
+        ::operator delete(p);
+}
+
+size_t
+arena::used() const
+{
+    return m_filled + m_top;
+}
+
+bool
+arena::owns(void const* const p) const
+{
+    char const* const c = static_cast<char const*>(p);
+    for (auto b = m_blocks.rbegin(); b != m_blocks.rend(); ++b)
+        if (c >= b->data.get() && c < b->data.get() + b->size)
+            return true;
+    return false;
+}
+
+void*
+arena::grow(size_t const bytes)
+{
+    size_t const last = m_blocks.empty() ? 0 : m_blocks.back().size;
+    size_t const size = std::max(bytes, std::max(minimum_block, 2 * last));
+    m_blocks.push_back(block{std::unique_ptr<char[]>(new char[size]), size});
+    m_filled += m_top;
+    m_top = bytes;
+    return m_blocks.back().data.get();
+}
+
+void
+arena::reset()
+{
+    // Trade the blocks for one that holds them all, so the next conversion
+    // of the same size never leaves it.
+    if (m_blocks.size() > 1) {
+        size_t size = 0;
+        for (block const& b: m_blocks)
+            size += b.size;
+        m_blocks.clear();
+        m_blocks.push_back(block{std::unique_ptr<char[]>(new char[size]), size});
+    }
+    m_top = 0;
+    m_filled = 0;
+}
+
+arena_scope::arena_scope():
+    m_arena(arena::local())
+{
+    ++m_arena.m_depth;
+}
+
+arena_scope::~arena_scope()
+{
+    if (--m_arena.m_depth == 0)
+        m_arena.reset();
+}
+
+heap_scope::heap_scope():
+    m_arena(arena::local()),
+    m_heap(m_arena.m_heap)
+{
+    m_arena.m_heap = true;
+}
+
+heap_scope::~heap_scope()
+{
+    m_arena.m_heap = m_heap;
+}
@@ -0,0 +1,119 @@
+#ifndef EXACT_FLOAT_ARENA_H
+#define EXACT_FLOAT_ARENA_H
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Per-thread storage for the temporaries of one conversion. While an
+// arena_scope is open on a thread, allocations come from blocks the thread
+// keeps for its whole life, and frees cost nothing. When the outermost scope
+// closes, everything it handed out is released at once. With no scope open,
+// or under a heap_scope, memory comes from the global heap as usual.
+class arena
+{
+public:
+    // The calling thread's arena
+    static arena& local();
+
+    void* allocate(size_t bytes);
+    void deallocate(void* p, size_t bytes);
+
+    // deallocate on the calling thread's arena, or on the heap once the
+    // thread's arena is gone. Statics such as cached tables are destroyed
+    // after the main thread's arena, and free their memory here.
+    static void deallocate_local(void* p, size_t bytes);
+
+    // Bytes handed out since the outermost scope opened
+    size_t used() const;
+private:
+    friend class arena_scope;
+    friend class heap_scope;
+    struct owner;
+
+    arena();
+    arena(arena const&) = delete;
+    arena& operator=(arena const&) = delete;
+
+    bool owns(void const* p) const;
+    void* grow(size_t bytes);
+    void reset();
+
+    struct block
+    {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+    std::vector<block> m_blocks;
+    // Next free byte in the last block
+    size_t m_top;
+    // Bytes in every block but the last
+    size_t m_filled;
+    unsigned m_depth;
+    bool m_heap;
+};
+
+// Routes the thread's arena_allocator allocations to its arena while alive.
+// Scopes nest; only the outermost one releases the memory.
+class arena_scope
+{
+public:
+    arena_scope();
+    ~arena_scope();
+
+    arena_scope(arena_scope const&) = delete;
+    arena_scope& operator=(arena_scope const&) = delete;
+private:
+    arena& m_arena;
+};
+
+// Sends allocations to the heap even inside an arena_scope, for values that
+// must outlive it, such as tables cached on first use.
+class heap_scope
+{
+public:
+    heap_scope();
+    ~heap_scope();
+
+    heap_scope(heap_scope const&) = delete;
+    heap_scope& operator=(heap_scope const&) = delete;
+private:
+    arena& m_arena;
+    bool const m_heap;
+};
+
+// A stateless allocator over the calling thread's arena, for the Allocator
+// parameter of cpp_int_backend. Memory from an arena must be freed on the
+// thread that allocated it, before its scope closes.
+template <typename T>
+struct arena_allocator
+{
+    typedef T value_type;
+
+    arena_allocator() = default;
+
+    template <typename U>
+    arena_allocator(arena_allocator<U> const&)
+    { }
+
+    T* allocate(size_t const n) {
+        return static_cast<T*>(arena::local().allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* const p, size_t const n) {
+        arena::deallocate_local(p, n * sizeof(T));
+    }
+};
+
+template <typename T, typename U>
+bool operator==(arena_allocator<T> const&, arena_allocator<U> const&)
+{
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(arena_allocator<T> const&, arena_allocator<U> const&)
+{
+    return false;
+}
+
+#endif
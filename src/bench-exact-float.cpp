@@ -0,0 +1,450 @@
+// Times each stage of the conversion over bands of typical and extreme
+// values, and prints the results as JSON for comparing builds.
+//
+//     bench-exact-float [--min-time MS] [--filter TEXT] [--perf]
+#include "exact-float.cpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <new>
+#include <random>
+#include <sstream>
+#include <boost/program_options.hpp>
+
+#ifdef HAVE_LINUX_PERF_EVENT_H
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Every allocation in the program passes through here, so a stage's bytes
+// per operation are the difference across its run.
+std::atomic<size_t> allocated_bytes(0);
+std::atomic<size_t> allocation_count(0);
+
+// Frees what operator new handed out. GCC takes the free in an inlined
+// operator delete as a mismatch with the new expression it belongs to, so
+// every delete calls this out of line instead.
+#ifdef __GNUC__
+__attribute__((noinline))
+#endif
+void
+release(void* const p) noexcept
+{
+    std::free(p);
+}
+
+}
+
+void*
+operator new(size_t const size)
+{
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* const p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void*
+operator new[](size_t const size)
+{
+    return operator new(size);
+}
+
+void
+operator delete(void* const p) noexcept
+{
+    release(p);
+}
+
+void
+operator delete[](void* const p) noexcept
+{
+    release(p);
+}
+
+void
+operator delete(void* const p, size_t) noexcept
+{
+    release(p);
+}
+
+void
+operator delete[](void* const p, size_t) noexcept
+{
+    release(p);
+}
+
+namespace {
+
+// A hardware event counted for this thread in user mode, if the kernel
+// allows it. A counter that couldn't be opened reads as unavailable.
+class perf_counter
+{
+public:
+    perf_counter(): m_fd(-1) { }
+
+    perf_counter(perf_counter const&) = delete;
+    perf_counter& operator=(perf_counter const&) = delete;
+
+    ~perf_counter() {
+#ifdef HAVE_LINUX_PERF_EVENT_H
+        if (m_fd >= 0)
+            ::close(m_fd);
+#endif
+    }
+
+    void open(std::uint64_t const config) {
+#ifdef HAVE_LINUX_PERF_EVENT_H
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof attr;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        m_fd = static_cast<int>(::syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+        (void)config;
+#endif
+    }
+
+    bool available() const {
+        return m_fd >= 0;
+    }
+
+    void start() {
+#ifdef HAVE_LINUX_PERF_EVENT_H
+        if (available()) {
+            ::ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+            ::ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    std::uint64_t stop() {
+        std::uint64_t count = 0;
+#ifdef HAVE_LINUX_PERF_EVENT_H
+        if (available()) {
+            ::ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (::read(m_fd, &count, sizeof count) != sizeof count)
+                count = 0;
+        }
+#endif
+        return count;
+    }
+private:
+    int m_fd;
+};
+
+struct options
+{
+    std::chrono::nanoseconds min_time;
+    std::string filter;
+    perf_counter cycles;
+    perf_counter cache_misses;
+};
+
+struct measurement
+{
+    double ns;
+    double bytes;
+    double allocations;
+    double cycles;
+    double cache_misses;
+};
+
+// Mixes in every stage's results and goes in the output, so the optimizer
+// can't discard them
+std::uint64_t checksum = 0;
+
+template <typename Integer>
+void
+consume(Integer const& value)
+{
+    checksum += static_cast<std::uint64_t>(Integer(value & 0xff));
+}
+
+// Run op over every input, once to warm up and then as many times as it
+// takes to fill the minimum time, and average over the operations.
+template <typename Op>
+measurement
+measure(size_t const count, Op op, options& opts)
+{
+    for (size_t i = 0; i < count; ++i)
+        op(i);
+
+    size_t const bytes = allocated_bytes.load();
+    size_t const allocations = allocation_count.load();
+    opts.cycles.start();
+    opts.cache_misses.start();
+    auto const start = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::steady_clock::duration::zero();
+    size_t ops = 0;
+    do {
+        for (size_t i = 0; i < count; ++i)
+            op(i);
+        ops += count;
+        elapsed = std::chrono::steady_clock::now() - start;
+    } while (elapsed < opts.min_time);
+    double const cycles = opts.cycles.stop();
+    double const cache_misses = opts.cache_misses.stop();
+
+    double const n = ops;
+    return {
+        std::chrono::duration<double, std::nano>(elapsed).count() / n,
+        (allocated_bytes.load() - bytes) / n,
+        (allocation_count.load() - allocations) / n,
+        cycles / n,
+        cache_misses / n,
+    };
+}
+
+// Runs op in its own arena_scope, as FloatInfo::write runs each conversion,
+// so arena_int temporaries cost what they do in a real conversion
+template <typename Op>
+struct in_arena
+{
+    Op op;
+
+    void operator()(size_t const i) {
+        arena_scope const scope;
+        op(i);
+    }
+};
+
+template <typename Op>
+in_arena<Op>
+make_in_arena(Op op)
+{
+    return {op};
+}
+
+// The inputs to every stage, worked out ahead of time so each stage is
+// timed alone
+template <typename Float, typename Integer>
+struct stage_inputs
+{
+    std::vector<Float> values;
+    std::vector<FloatInfo> infos;
+    std::vector<Integer> mantissas;
+    std::vector<int> bin_exps;
+    std::vector<Integer> minimized;
+    std::vector<int> minimized_exps;
+    std::vector<Integer> whole;
+    std::vector<int> whole_bin_exps;
+    std::vector<int> dec_exps;
+    std::vector<Integer> reduced;
+
+    explicit stage_inputs(std::vector<Float> const& v): values(v) {
+        for (Float const value: values) {
+            infos.push_back(FloatInfo(value));
+            FloatInfo const& info = infos.back();
+            mp::cpp_int man;
+            int bin_exp;
+            info.decompose(man, bin_exp);
+            mantissas.push_back(Integer(man));
+            bin_exps.push_back(bin_exp);
+
+            Integer m;
+            int e;
+            std::tie(m, e) = minimize_mantissa(mantissas.back(), bin_exp);
+            minimized.push_back(m);
+            minimized_exps.push_back(e);
+            int d;
+            std::tie(m, e, d) = remove_fraction(m, e);
+            whole.push_back(m);
+            whole_bin_exps.push_back(e);
+            dec_exps.push_back(d);
+            reduced.push_back(reduce_binary_exponent(m, e));
+        }
+    }
+};
+
+void
+report(bool& first_result, char const* type, char const* band, char const* stage, measurement const& m,
+       options const& opts)
+{
+    std::printf("%s\n    {\"type\": \"%s\", \"band\": \"%s\", \"stage\": \"%s\", \"ns_per_op\": %.2f, "
+                "\"bytes_per_op\": %.1f, \"allocations_per_op\": %.3f",
+                first_result ? "" : ",", type, band, stage, m.ns, m.bytes, m.allocations);
+    if (opts.cycles.available())
+        std::printf(", \"cycles_per_op\": %.1f", m.cycles);
+    if (opts.cache_misses.available())
+        std::printf(", \"cache_misses_per_op\": %.3f", m.cache_misses);
+    std::printf("}");
+    std::fflush(stdout);
+    first_result = false;
+}
+
+template <typename Op>
+void
+run_stage(bool& first_result, char const* type, char const* band, char const* stage, size_t const count, Op op,
+          options& opts)
+{
+    std::string const name = std::string(type) + "/" + band + "/" + stage;
+    if (name.find(opts.filter) != std::string::npos)
+        report(first_result, type, band, stage, measure(count, op, opts), opts);
+}
+
+// Time every stage of converting values, with Integer for the stages
+// float_descriptors' write_decimal runs
+template <typename Float, typename Integer>
+void
+run_stages(bool& first_result, char const* type, char const* band, std::vector<Float> const& values, options& opts)
+{
+    stage_inputs<Float, Integer> const in(values);
+    size_t longest = 0;
+    for (FloatInfo const& info: in.infos)
+        longest = std::max(longest, exact_length(info));
+    std::vector<char> buffer(longest);
+    char* const first = buffer.data();
+    char* const last = first + buffer.size();
+    exact_format const format;
+    mp::cpp_int rec;
+    std::ostringstream os;
+
+    run_stage(first_result, type, band, "to_float_rec", values.size(), [&](size_t const i) {
+        to_float_rec(in.values[i], rec);
+        consume(rec);
+    }, opts);
+    run_stage(first_result, type, band, "get_float_type", values.size(), [&](size_t const i) {
+        std::uint32_t exponent;
+        std::uint64_t mantissa;
+        detail::split_fields(in.values[i], exponent, mantissa);
+        checksum += get_float_type(exponent, mantissa, float_traits<Float>::kind);
+    }, opts);
+    run_stage(first_result, type, band, "minimize_mantissa", values.size(), make_in_arena([&](size_t const i) {
+        consume(std::get<0>(minimize_mantissa(in.mantissas[i], in.bin_exps[i])));
+    }), opts);
+    run_stage(first_result, type, band, "remove_fraction", values.size(), make_in_arena([&](size_t const i) {
+        consume(std::get<0>(remove_fraction(in.minimized[i], in.minimized_exps[i])));
+    }), opts);
+    run_stage(first_result, type, band, "reduce_binary_exponent", values.size(), make_in_arena([&](size_t const i) {
+        consume(reduce_binary_exponent(in.whole[i], in.whole_bin_exps[i]));
+    }), opts);
+    run_stage(first_result, type, band, "build_result", values.size(), make_in_arena([&](size_t const i) {
+        checksum += build_result(first, last, in.dec_exps[i], in.reduced[i], false, format).ptr - first;
+    }), opts);
+    run_stage(first_result, type, band, "exact_to_chars", values.size(), [&](size_t const i) {
+        checksum += exact_to_chars(first, last, in.values[i]).ptr - first;
+    }, opts);
+    run_stage(first_result, type, band, "operator<<", values.size(), [&](size_t const i) {
+        os.seekp(0);
+        os << exact(in.values[i]);
+    }, opts);
+}
+
+template <typename Float>
+void
+run_band(bool& first_result, char const* type, char const* band, std::vector<Float> const& values, options& opts)
+{
+    run_stages<Float, fixed_uint<Float>>(first_result, type, band, values, opts);
+}
+
+#ifdef BOOST_FLOAT80_C
+// Extended values convert with the integer write_extended picks: arena_int,
+// or under USE_GMP, mpz_int for a band with values past gmp_threshold.
+template <>
+void
+run_band(bool& first_result, char const* type, char const* band, std::vector<boost::float80_t> const& values,
+         options& opts)
+{
+#ifdef USE_GMP
+    for (boost::float80_t const value: values) {
+        mp::cpp_int man;
+        int bin_exp;
+        FloatInfo(value).decompose(man, bin_exp);
+        if (extended_uses_gmp(bin_exp)) {
+            run_stages<boost::float80_t, mp::mpz_int>(first_result, type, band, values, opts);
+            return;
+        }
+    }
+#endif
+    run_stages<boost::float80_t, arena_int>(first_result, type, band, values, opts);
+}
+#endif
+
+// Each band holds the same number of values, drawn from a fixed seed so
+// every run times the same inputs.
+template <typename Float>
+void
+run_type(bool& first_result, char const* type, options& opts)
+{
+    size_t const count = 256;
+    std::mt19937_64 random(42);
+    std::vector<Float> values(count);
+
+    int const integer_bits = std::min(std::numeric_limits<Float>::digits, 24);
+    for (Float& value: values)
+        value = Float(random() % (std::uint64_t(1) << integer_bits) + 1);
+    run_band(first_result, type, "integers", values, opts);
+
+    std::uniform_real_distribution<double> fraction(1e-3, 1);
+    for (Float& value: values)
+        value = Float(fraction(random));
+    run_band(first_result, type, "small_fractions", values, opts);
+
+    std::uniform_real_distribution<double> scale(0.5, 1);
+    for (Float& value: values)
+        value = std::numeric_limits<Float>::max() * Float(scale(random));
+    run_band(first_result, type, "huge", values, opts);
+
+    // A few low bits of mantissa, as far below the normal range as it goes
+    for (Float& value: values)
+        value = std::numeric_limits<Float>::denorm_min() * Float(random() % 4096 + 1);
+    run_band(first_result, type, "deep_denormals", values, opts);
+}
+
+}
+
+int
+main(int argc, char const* argv[])
+{
+    namespace po = boost::program_options;
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help", "display program help")
+        ("min-time", po::value<unsigned>()->default_value(50), "run each stage for at least this many milliseconds")
+        ("filter", po::value<std::string>()->default_value(""), "only run stages whose type/band/stage contains this")
+        ("perf", "also count cycles and cache misses with perf_event_open, where permitted")
+        ;
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+    if (vm.count("help")) {
+        std::cout << desc << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    options opts;
+    opts.min_time = std::chrono::milliseconds(vm["min-time"].as<unsigned>());
+    opts.filter = vm["filter"].as<std::string>();
+    if (vm.count("perf")) {
+#ifdef HAVE_LINUX_PERF_EVENT_H
+        opts.cycles.open(PERF_COUNT_HW_CPU_CYCLES);
+        opts.cache_misses.open(PERF_COUNT_HW_CACHE_MISSES);
+#endif
+        if (!opts.cycles.available())
+            std::cerr << "Hardware counters aren't available; reporting times only" << std::endl;
+    }
+
+    std::printf("{\n  \"package\": \"%s\",\n  \"results\": [", PACKAGE_STRING);
+    bool first_result = true;
+#ifdef BOOST_FLOAT80_C
+    run_type<boost::float80_t>(first_result, "float80", opts);
+#endif
+#ifdef BOOST_FLOAT64_C
+    run_type<boost::float64_t>(first_result, "float64", opts);
+#endif
+#ifdef BOOST_FLOAT32_C
+    run_type<boost::float32_t>(first_result, "float32", opts);
+#endif
+    std::printf("\n  ],\n  \"checksum\": %llu\n}\n", static_cast<unsigned long long>(checksum));
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,537 @@
+#include "config.h"
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include "decimal-parse.h"
+#include "exact-float.h"
+
+namespace {
+
+bool
+is_digit(char const c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// Advance past word, an ASCII lowercase string, if the text starts with it
+// in any case.
+bool
+skip_word(char const*& first, char const* const last, char const* word)
+{
+    char const* p = first;
+    for (; *word; ++word, ++p) {
+        if (p == last || (*p | 0x20) != *word)
+            return false;
+    }
+    first = p;
+    return true;
+}
+
+// Exponents stop growing here, far beyond any float's range, so they can't
+// overflow.
+std::int64_t const exponent_limit = 1000000000;
+
+// Largest decimal magnitude worth dividing out; anything beyond it is an
+// infinity or a zero in every float type.
+std::int64_t const magnitude_limit = 5000;
+
+std::uint64_t const powers_of_ten[] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull,
+    1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull,
+    100000000000000ull, 1000000000000000ull, 10000000000000000ull, 100000000000000000ull,
+    1000000000000000000ull, 10000000000000000000ull,
+};
+
+int
+leading_zeros(std::uint64_t const value)
+{
+#ifdef __GNUC__
+    return __builtin_clzll(value);
+#else
+    int count = 0;
+    for (std::uint64_t bit = std::uint64_t(1) << 63; !(value & bit); bit >>= 1)
+        ++count;
+    return count;
+#endif
+}
+
+struct uint128
+{
+    std::uint64_t high;
+    std::uint64_t low;
+};
+
+uint128
+multiply(std::uint64_t const a, std::uint64_t const b)
+{
+#ifdef __SIZEOF_INT128__
+    __extension__ typedef unsigned __int128 native_uint128;
+    native_uint128 const product = static_cast<native_uint128>(a) * b;
+    return { std::uint64_t(product >> 64), std::uint64_t(product) };
+#else
+    std::uint64_t const a_low = a & 0xffffffff, a_high = a >> 32;
+    std::uint64_t const b_low = b & 0xffffffff, b_high = b >> 32;
+    std::uint64_t const low = a_low * b_low;
+    std::uint64_t const middle1 = a_high * b_low + (low >> 32);
+    std::uint64_t const middle2 = a_low * b_high + (middle1 & 0xffffffff);
+    return { a_high * b_high + (middle1 >> 32) + (middle2 >> 32), (middle2 << 32) | (low & 0xffffffff) };
+#endif
+}
+
+// 5^q for every q in [smallest_power, largest_power], each scaled by a power
+// of two into [2^127, 2^128). Positive powers are truncated and negative
+// ones rounded up, so the Eisel-Lemire product errs in a known direction.
+int const smallest_power = -342;
+int const largest_power = 308;
+
+struct power_table
+{
+    std::uint64_t values[2 * (largest_power - smallest_power + 1)];
+
+    power_table() {
+        mp::cpp_int const one = 1;
+        mp::cpp_int const top = one << 128;
+        mp::cpp_int power = 1;
+        for (int q = 0; q <= largest_power; ++q, power *= 5) {
+            int const bits = int(mp::msb(power)) + 1;
+            store(q, bits < 128 ? mp::cpp_int(power << (128 - bits)) : mp::cpp_int(power >> (bits - 128)));
+        }
+        power = 5;
+        for (int q = -1; q >= smallest_power; --q, power *= 5) {
+            int const z = int(mp::msb(power)) + 1;
+            int const b = q >= -27 ? z + 127 : 2 * z + 128;
+            mp::cpp_int scaled = (one << b) / power + 1;
+            while (scaled >= top)
+                scaled >>= 1;
+            store(q, scaled);
+        }
+    }
+
+    void store(int const q, mp::cpp_int const& power) {
+        std::size_t const index = 2 * (q - smallest_power);
+        values[index] = static_cast<std::uint64_t>(power >> 64);
+        values[index + 1] = static_cast<std::uint64_t>(power & ~std::uint64_t(0));
+    }
+};
+
+std::uint64_t const*
+powers_of_five()
+{
+    static power_table const table;
+    return table.values;
+}
+
+// Enough of w * 5^q to round to Precision bits, reading the second half of
+// the power only when the first leaves the answer in doubt
+template <int Precision>
+uint128
+product_approximation(std::int64_t const q, std::uint64_t const w)
+{
+    std::uint64_t const* const power = powers_of_five() + 2 * (q - smallest_power);
+    uint128 product = multiply(w, power[0]);
+    std::uint64_t const precision_mask = ~std::uint64_t(0) >> Precision;
+    if ((product.high & precision_mask) == precision_mask) {
+        uint128 const second = multiply(w, power[1]);
+        product.low += second.high;
+        if (second.high > product.low)
+            ++product.high;
+    }
+    return product;
+}
+
+// The range of q for which a product can land exactly halfway between two
+// floats, from Lemire's "Number Parsing at a Gigabyte per Second"
+template <typename Float>
+struct round_to_even_range;
+
+#ifdef BOOST_FLOAT64_C
+template <>
+struct round_to_even_range<boost::float64_t>
+{
+    static int const min = -4;
+    static int const max = 23;
+};
+#endif
+
+#ifdef BOOST_FLOAT32_C
+template <>
+struct round_to_even_range<boost::float32_t>
+{
+    static int const min = -17;
+    static int const max = 10;
+};
+#endif
+
+// Round w * 10^q to a biased exponent and stored mantissa. Returns false
+// when 128 bits of the power of five can't settle it.
+template <typename Float>
+bool
+eisel_lemire(std::int64_t const q, std::uint64_t w, std::int32_t& power2, std::uint64_t& mantissa)
+{
+    using traits = float_traits<Float>;
+    int const mantissa_bits = traits::mantissa_bits;
+    int const infinite_power = traits::exponent_mask;
+    if (w == 0 || q < smallest_power) {
+        power2 = 0;
+        mantissa = 0;
+        return true;
+    }
+    if (q > largest_power) {
+        power2 = infinite_power;
+        mantissa = 0;
+        return true;
+    }
+
+    int const lz = leading_zeros(w);
+    w <<= lz;
+    uint128 const product = product_approximation<traits::mantissa_bits + 3>(q, w);
+    // The truncated power might be off by enough to matter only outside the
+    // range where 5^q fits in 128 bits.
+    if (product.low == ~std::uint64_t(0) && (q < -27 || q > 55))
+        return false;
+
+    int const upper_bit = int(product.high >> 63);
+    int const shift = upper_bit + 64 - mantissa_bits - 3;
+    mantissa = product.high >> shift;
+    power2 = std::int32_t(((152170 + 65536) * q) >> 16) + 63 + upper_bit - lz + int(traits::exponent_bias);
+
+    if (power2 <= 0) {
+        // Denormal, or nothing at all. Exact ties can't happen this small.
+        if (-power2 + 1 >= 64) {
+            power2 = 0;
+            mantissa = 0;
+            return true;
+        }
+        mantissa >>= -power2 + 1;
+        mantissa += mantissa & 1;
+        mantissa >>= 1;
+        // Rounding up may have reached the smallest normal number.
+        power2 = mantissa < (std::uint64_t(1) << mantissa_bits) ? 0 : 1;
+        mantissa &= traits::mantissa_mask;
+        return true;
+    }
+
+    // An exact tie rounds to even, not up.
+    if (product.low <= 1 && q >= round_to_even_range<Float>::min && q <= round_to_even_range<Float>::max
+        && (mantissa & 3) == 1 && (mantissa << shift) == product.high)
+        mantissa &= ~std::uint64_t(1);
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >= (std::uint64_t(2) << mantissa_bits)) {
+        mantissa = std::uint64_t(1) << mantissa_bits;
+        ++power2;
+    }
+    mantissa &= traits::mantissa_mask;
+    if (power2 >= infinite_power) {
+        power2 = infinite_power;
+        mantissa = 0;
+    }
+    return true;
+}
+
+template <typename Float>
+typename std::enable_if<float_traits<Float>::bits <= 64, Float>::type
+assemble(std::int32_t const power2, std::uint64_t const mantissa)
+{
+    using traits = float_traits<Float>;
+    typename detail::float_word<traits::bits>::type const word = std::uint64_t(power2) << traits::mantissa_bits
+                                                                  | mantissa;
+    Float result;
+    std::memcpy(&result, &word, sizeof result);
+    return result;
+}
+
+// Try Eisel-Lemire. With digits missing from w, the answer counts only if
+// rounding w and w + 1 agree, since the true value lies between them.
+template <typename Float>
+typename std::enable_if<float_traits<Float>::bits <= 64, bool>::type
+fast_path(std::int64_t const q, std::uint64_t const w, bool const truncated, Float& result)
+{
+    std::int32_t power2;
+    std::uint64_t mantissa;
+    if (!eisel_lemire<Float>(q, w, power2, mantissa))
+        return false;
+    if (truncated) {
+        std::int32_t next_power2;
+        std::uint64_t next_mantissa;
+        if (!eisel_lemire<Float>(q, w + 1, next_power2, next_mantissa)
+            || next_power2 != power2 || next_mantissa != mantissa)
+            return false;
+    }
+    result = assemble<Float>(power2, mantissa);
+    return true;
+}
+
+// The 128-bit table is too narrow for a 64-bit significand.
+template <typename Float>
+typename std::enable_if<(float_traits<Float>::bits > 64), bool>::type
+fast_path(std::int64_t, std::uint64_t, bool, Float&)
+{
+    return false;
+}
+
+// Powers of ten that Float holds exactly
+template <typename Float>
+struct exact_powers
+{
+    Float values[28];
+    int count;
+
+    exact_powers(): count(0) {
+        // 10^n is exact while 5^n fits in the significand.
+        int const digits = std::numeric_limits<Float>::digits;
+        std::uint64_t five = 1;
+        Float ten = 1;
+        while (count < int(sizeof values / sizeof values[0]) && (digits >= 64 || five >> (digits % 64) == 0)) {
+            values[count++] = ten;
+            if (five > ~std::uint64_t(0) / 5)
+                break;
+            five *= 5;
+            ten *= 10;
+        }
+    }
+};
+
+// Clinger's fast path: when w and 10^|q| are both exact in Float, one
+// correctly rounded multiplication or division gives the answer. That holds
+// only if the arithmetic really happens in Float's precision.
+template <typename Float>
+bool
+clinger(std::int64_t const q, std::uint64_t const w, Float& result)
+{
+    bool const exact_arithmetic = FLT_EVAL_METHOD == 0 || std::is_same<Float, long double>::value;
+    int const digits = std::numeric_limits<Float>::digits;
+    static exact_powers<Float> const powers;
+    if (!exact_arithmetic || (digits < 64 && w > std::uint64_t(1) << (digits % 64))
+        || q <= -powers.count || q >= powers.count)
+        return false;
+    result = q < 0 ? Float(w) / powers.values[-q] : Float(w) * powers.values[q];
+    return true;
+}
+
+}
+
+decimal_value::decimal_value():
+    m_category(category::finite), m_negative(false), m_truncated(false), m_digits(0), m_exponent(0),
+    m_first(nullptr), m_last(nullptr), m_significant(0), m_full_exponent(0)
+{ }
+
+std::errc
+decimal_value::parse(char const* first, char const* const last)
+{
+    *this = decimal_value();
+    if (first != last && (*first == '+' || *first == '-'))
+        m_negative = *first++ == '-';
+
+    if (first != last && !is_digit(*first) && *first != '.') {
+        if (skip_word(first, last, "inf")) {
+            skip_word(first, last, "inity");
+            m_category = category::infinity;
+        } else if (skip_word(first, last, "nan")) {
+            if (first != last && *first == '(') {
+                do
+                    ++first;
+                while (first != last && (is_digit(*first) || ((*first | 0x20) >= 'a' && (*first | 0x20) <= 'z')
+                                         || *first == '_'));
+                if (first == last || *first++ != ')')
+                    return std::errc::invalid_argument;
+            }
+            m_category = category::nan;
+        } else {
+            return std::errc::invalid_argument;
+        }
+        return first == last ? std::errc() : std::errc::invalid_argument;
+    }
+
+    // The first 19 significant digits go into m_digits, and the rest only
+    // count toward the exponent and m_truncated.
+    int kept = 0;
+    bool any_digits = false;
+    char const* point = nullptr;
+    for (; first != last; ++first) {
+        if (*first == '.' && !point) {
+            point = first;
+            continue;
+        }
+        if (!is_digit(*first))
+            break;
+        any_digits = true;
+        int const digit = *first - '0';
+        if (!m_first) {
+            if (digit == 0) {
+                if (point && m_exponent > -exponent_limit)
+                    --m_exponent;
+                continue;
+            }
+            m_first = first;
+        }
+        m_last = first + 1;
+        ++m_significant;
+        if (kept < 19) {
+            m_digits = m_digits * 10 + digit;
+            ++kept;
+            if (point)
+                --m_exponent;
+        } else {
+            m_truncated = m_truncated || digit != 0;
+            if (!point && m_exponent < exponent_limit)
+                ++m_exponent;
+        }
+    }
+    if (!any_digits)
+        return std::errc::invalid_argument;
+
+    std::int64_t explicit_exponent = 0;
+    if (first != last && (*first | 0x20) == 'e') {
+        ++first;
+        bool negative_exponent = false;
+        if (first != last && (*first == '+' || *first == '-'))
+            negative_exponent = *first++ == '-';
+        if (first == last || !is_digit(*first))
+            return std::errc::invalid_argument;
+        for (; first != last && is_digit(*first); ++first) {
+            if (explicit_exponent < exponent_limit)
+                explicit_exponent = explicit_exponent * 10 + (*first - '0');
+        }
+        if (negative_exponent)
+            explicit_exponent = -explicit_exponent;
+    }
+    if (first != last)
+        return std::errc::invalid_argument;
+
+    m_exponent += explicit_exponent;
+    // The digits from m_first on form an integer; scale it by the explicit
+    // exponent less however many of them follow the decimal point.
+    if (m_first) {
+        std::int64_t const fraction_digits = point && point < m_last ? m_last - point - 1 : 0;
+        m_full_exponent = explicit_exponent - fraction_digits;
+    }
+    return std::errc();
+}
+
+#ifdef BOOST_FLOAT80_C
+std::errc
+decimal_value::to(boost::float80_t& result) const
+{
+    return convert(result);
+}
+#endif
+
+#ifdef BOOST_FLOAT64_C
+std::errc
+decimal_value::to(boost::float64_t& result) const
+{
+    return convert(result);
+}
+#endif
+
+#ifdef BOOST_FLOAT32_C
+std::errc
+decimal_value::to(boost::float32_t& result) const
+{
+    return convert(result);
+}
+#endif
+
+template <typename Float>
+std::errc
+decimal_value::convert(Float& result) const
+{
+    std::errc ec = std::errc();
+    switch (m_category) {
+        case category::infinity:
+            result = std::numeric_limits<Float>::infinity();
+            break;
+        case category::nan:
+            result = std::numeric_limits<Float>::quiet_NaN();
+            break;
+        case category::finite:
+            if (m_digits == 0)
+                result = 0;
+            else if ((m_truncated || !clinger(m_exponent, m_digits, result))
+                     && !fast_path(m_exponent, m_digits, m_truncated, result))
+                return convert_exactly(result);
+            if (std::isinf(result))
+                ec = std::errc::result_out_of_range;
+            break;
+    }
+    if (m_negative)
+        result = -result;
+    return ec;
+}
+
+// Divide the whole decimal out with big integers: the digits times 10^E
+// become num / den, scaled by 2^s so the quotient has two or three bits
+// more than Float holds, and those and the remainder decide the rounding.
+template <typename Float>
+std::errc
+decimal_value::convert_exactly(Float& result) const
+{
+    using traits = float_traits<Float>;
+    int const digits = traits::digits;
+    // The exponent of the smallest denormal's unit bit
+    std::int64_t const min_exponent = 1 - std::int64_t(traits::exponent_bias) - (digits - 1);
+    std::int64_t const magnitude = m_full_exponent + std::int64_t(m_significant);
+
+    if (magnitude > magnitude_limit) {
+        result = std::numeric_limits<Float>::infinity();
+    } else if (magnitude < -magnitude_limit) {
+        result = 0;
+    } else {
+        mp::cpp_int num = 0;
+        std::uint64_t chunk = 0;
+        int chunk_digits = 0;
+        for (char const* p = m_first; p != m_last; ++p) {
+            if (*p == '.')
+                continue;
+            chunk = chunk * 10 + (*p - '0');
+            if (++chunk_digits == 19) {
+                num = num * powers_of_ten[19] + chunk;
+                chunk = 0;
+                chunk_digits = 0;
+            }
+        }
+        num = num * powers_of_ten[chunk_digits] + chunk;
+
+        mp::cpp_int den = 1;
+        if (m_full_exponent >= 0)
+            num *= mp::pow(mp::cpp_int(10), unsigned(m_full_exponent));
+        else
+            den = mp::pow(mp::cpp_int(10), unsigned(-m_full_exponent));
+
+        std::int64_t const s = digits + std::int64_t(mp::msb(den)) - std::int64_t(mp::msb(num)) + 1;
+        if (s >= 0)
+            num <<= unsigned(s);
+        else
+            den <<= unsigned(-s);
+        mp::cpp_int quotient, remainder;
+        mp::divide_qr(num, den, quotient, remainder);
+
+        // Drop the extra bits, and more for a denormal.
+        std::int64_t drop = std::int64_t(mp::msb(quotient)) + 1 - digits;
+        std::int64_t exponent = drop - s;
+        if (exponent < min_exponent) {
+            drop += min_exponent - exponent;
+            exponent = min_exponent;
+        }
+        bool const half = drop > 0 && mp::bit_test(quotient, unsigned(drop - 1));
+        bool const sticky = remainder != 0
+            || (drop > 1 && mp::lsb(quotient) < unsigned(drop - 1));
+        mp::cpp_int mantissa = drop > 0 ? mp::cpp_int(quotient >> unsigned(drop)) : quotient;
+        if (half && (sticky || mp::bit_test(mantissa, 0)))
+            ++mantissa;
+        // Rounding up can carry into a new top bit.
+        if (mantissa != 0 && mp::msb(mantissa) >= unsigned(digits)) {
+            mantissa >>= 1;
+            ++exponent;
+        }
+        result = std::ldexp(Float(static_cast<std::uint64_t>(mantissa)), int(exponent));
+    }
+
+    std::errc const ec = std::isinf(result) ? std::errc::result_out_of_range : std::errc();
+    if (m_negative)
+        result = -result;
+    return ec;
+}
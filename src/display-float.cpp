@@ -1,31 +1,153 @@
 #undef _GLIBCXX_DEBUG
 #include "config.h"
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <iomanip>
 #include <string>
+#include <vector>
 #include <boost/cstdfloat.hpp>
 #include <boost/lexical_cast.hpp>
 
+// Two hex digits for every byte value
+struct hex_table
+{
+    char digits[256][2];
+
+    hex_table() {
+        char const* const hex = "0123456789abcdef";
+        for (int i = 0; i < 256; ++i) {
+            digits[i][0] = hex[i >> 4];
+            digits[i][1] = hex[i & 0xf];
+        }
+    }
+};
+
+hex_table const hex_bytes;
+
+// Write the bytes of f as hex digits starting at out, and return the end.
 template <typename Float>
-std::string as_hex(Float const& f)
+char* write_hex(Float const& f, char* out)
 {
-    std::ostringstream result;
-    auto float_size = sizeof(Float) == 16 ? 10u : sizeof(Float);
+    auto const float_size = sizeof(Float) == 16 ? 10u : sizeof(Float);
 #ifdef BOOST_LITTLE_ENDIAN
     unsigned char const* x = reinterpret_cast<unsigned char const*>(&f) + float_size - 1;
-    for (auto i = 0; i < float_size; ++i, --x)
+    for (auto i = 0u; i < float_size; ++i, --x, out += 2)
 #else
     unsigned char const* x = reinterpret_cast<unsigned char const*>(&f);
-    for (auto i = 0; i < float_size; ++i, ++x)
+    for (auto i = 0u; i < float_size; ++i, ++x, out += 2)
 #endif
     {
-	result << std::hex << std::setw(2) << std::setfill('0') << static_cast<unsigned int>(*x);
+        std::memcpy(out, hex_bytes.digits[*x], 2);
     }
-    return result.str();
+    return out;
+}
+
+template <typename Float>
+std::string as_hex(Float const& f)
+{
+    char digits[2 * sizeof(Float)];
+    return std::string(digits, write_hex(f, digits));
+}
+
+// Parse all of text with the strto* function for Float, without exceptions.
+// Like lexical_cast, reject leading blanks, which strto* would skip, trailing
+// characters, hexadecimal, and results too large to represent.
+template <typename Float>
+bool parse(std::string const& text, Float (*convert)(char const*, char**), Float& result)
+{
+    if (text.empty() || std::isspace(static_cast<unsigned char>(text[0])))
+        return false;
+    if (text.find_first_of("xX") != std::string::npos)
+        return false;
+    char* end;
+    errno = 0;
+    result = convert(text.c_str(), &end);
+    return end == text.c_str() + text.size() && !(errno == ERANGE && std::isinf(result));
 }
 
-int main()
+// Append one output line for value, or return false if it doesn't parse.
+template <typename Float>
+bool append_line(std::string const& value, Float (*convert)(char const*, char**), char const* prefix,
+                 std::string& out)
 {
+    Float f;
+    if (!parse(value, convert, f))
+        return false;
+    char digits[2 * sizeof(Float)];
+    out += value;
+    out += prefix;
+    out.append(digits, write_hex(f, digits));
+    out += '\n';
+    return true;
+}
+
+// The same output as the line-at-a-time loop in main, but for lists of
+// millions of values: input arrives in large blocks, parsing never throws,
+// and output collects in one buffer that's written a megabyte at a time.
+int run_batch()
+{
+    std::vector<char> block(1 << 20);
+    std::string pending;
+    std::string out;
+    out.reserve(2 << 20);
+    bool more = true;
+    while (more) {
+        size_t const size = std::fread(block.data(), 1, block.size(), stdin);
+        more = size > 0;
+        char const* first = block.data();
+        char const* const last = first + size;
+        for (;;) {
+            char const* const newline = static_cast<char const*>(std::memchr(first, '\n', last - first));
+            if (!newline && more) {
+                pending.append(first, last);
+                break;
+            }
+            pending.append(first, newline ? newline : last);
+            if (!newline && pending.empty())
+                break;
+            bool parsed = true;
+#ifdef BOOST_FLOAT80_C
+            parsed = parsed && append_line<boost::float80_t>(pending, std::strtold, " = ", out);
+#endif
+#ifdef BOOST_FLOAT64_C
+            parsed = parsed && append_line<boost::float64_t>(pending, std::strtod, " = ", out);
+#endif
+#ifdef BOOST_FLOAT32_C
+            parsed = parsed && append_line<boost::float32_t>(pending, std::strtof, " = 0x", out);
+#endif
+            if (!parsed) {
+                std::fwrite(out.data(), 1, out.size(), stdout);
+                std::fflush(stdout);
+                std::cerr << pending << " doesn't look like a number." << std::endl;
+                return EXIT_FAILURE;
+            }
+            pending.clear();
+            if (out.size() >= (1u << 20)) {
+                std::fwrite(out.data(), 1, out.size(), stdout);
+                out.clear();
+            }
+            if (!newline)
+                break;
+            first = newline + 1;
+        }
+    }
+    std::fwrite(out.data(), 1, out.size(), stdout);
+    if (std::ferror(stdin) || std::fflush(stdout) != 0) {
+        std::cerr << "Error reading input or writing output" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char const* argv[])
+{
+    if (argc > 1 && std::strcmp(argv[1], "--batch") == 0)
+        return run_batch();
+
     std::string value;
     while (std::getline(std::cin, value)) {
 #ifdef BOOST_FLOAT80_C
@@ -0,0 +1,196 @@
+#include "config.h"
+#include <algorithm>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "exact-cache.h"
+
+namespace {
+
+// The most shards a cache divides into, each with its own lock, and the
+// fewest entries a shard holds; smaller shards would evict too eagerly when
+// a few of them get most of the values.
+size_t const max_shards = 64;
+size_t const min_shard_capacity = 64;
+
+// Every field that tells values apart; the float_type follows from them.
+struct cache_key
+{
+    std::uint64_t mantissa;
+    std::uint64_t rest;
+
+    explicit cache_key(FloatInfo const& info):
+        mantissa(info.mantissa),
+        rest(std::uint64_t(std::uint32_t(info.exponent)) << 16 | unsigned(info.kind) << 8 | info.negative)
+    { }
+
+    bool operator==(cache_key const& other) const {
+        return mantissa == other.mantissa && rest == other.rest;
+    }
+
+    // Mixes every field bit into every hash bit, so both the shard, taken
+    // from the high bits, and the bucket are spread evenly.
+    std::uint64_t hash() const {
+        std::uint64_t h = (mantissa ^ (rest * 0x9e3779b97f4a7c15u)) * 0xbf58476d1ce4e5b9u;
+        h ^= h >> 31;
+        h *= 0x94d049bb133111ebu;
+        return h ^ (h >> 29);
+    }
+};
+
+struct key_hash
+{
+    size_t operator()(cache_key const& key) const {
+        return key.hash();
+    }
+};
+
+size_t
+shard_index(cache_key const& key, size_t const shard_count)
+{
+    return (key.hash() >> 32) % shard_count;
+}
+
+}
+
+struct exact_cache::shard
+{
+    typedef std::pair<cache_key, std::string> entry;
+
+    std::mutex mutex;
+    // Most recently used first
+    std::list<entry> entries;
+    std::unordered_map<cache_key, std::list<entry>::iterator, key_hash> index;
+    size_t capacity;
+    std::uint64_t hits;
+    std::uint64_t misses;
+
+    shard():
+        capacity(0), hits(0), misses(0)
+    { }
+
+    // Copy the text kept for key to [first, last) and set length to its
+    // size. Returns false when there is none. Nothing is copied when it
+    // doesn't fit, but length is still set.
+    bool find(cache_key const& key, char* const first, char* const last, size_t& length) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto const found = index.find(key);
+        if (found == index.end())
+            return false;
+        std::string const& text = found->second->second;
+        length = text.size();
+        if (size_t(last - first) < length)
+            return true;
+        entries.splice(entries.begin(), entries, found->second);
+        ++hits;
+        std::copy(text.begin(), text.end(), first);
+        return true;
+    }
+
+    // Keep [first, last) as the text for key, which just missed.
+    void add(cache_key const& key, char const* const first, char const* const last) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++misses;
+        // Another thread may have added it in the meantime.
+        if (capacity == 0 || index.count(key) != 0)
+            return;
+        if (entries.size() < capacity) {
+            entries.emplace_front(key, std::string(first, last));
+        } else {
+            // Reuse the oldest entry, and its string's storage, for this one.
+            index.erase(entries.back().first);
+            entries.splice(entries.begin(), entries, std::prev(entries.end()));
+            entries.front().first = key;
+            entries.front().second.assign(first, last);
+        }
+        index.emplace(key, entries.begin());
+    }
+};
+
+exact_cache::exact_cache(size_t const capacity, exact_format const& format):
+    m_format(format),
+    m_shard_count(std::max<size_t>(1, std::min(max_shards, capacity / min_shard_capacity))),
+    m_shards(new shard[m_shard_count])
+{
+    for (size_t i = 0; i < m_shard_count; ++i)
+        m_shards[i].capacity = capacity / m_shard_count + (i < capacity % m_shard_count);
+}
+
+exact_cache::~exact_cache()
+{
+}
+
+exact_to_chars_result
+exact_cache::to_chars(char* const first, char* const last, FloatInfo const& info)
+{
+    cache_key const key(info);
+    shard& s = m_shards[shard_index(key, m_shard_count)];
+    size_t length;
+    if (s.find(key, first, last, length)) {
+        if (size_t(last - first) < length)
+            return {last, std::errc::value_too_large};
+        return {first + length, std::errc()};
+    }
+
+    // Convert without holding the lock.
+    exact_to_chars_result const result = exact_to_chars(first, last, info, m_format);
+    if (result.ec == std::errc())
+        s.add(key, first, result.ptr);
+    return result;
+}
+
+void
+exact_cache::write(std::ostream& os, FloatInfo const& info)
+{
+    cache_key const key(info);
+    shard& s = m_shards[shard_index(key, m_shard_count)];
+    char local[512];
+    std::vector<char> buffer;
+    char* first = local;
+    size_t length;
+    bool found = s.find(key, first, first + sizeof local, length);
+    if (found && length > sizeof local) {
+        buffer.resize(length);
+        first = buffer.data();
+        // It may have been dropped since.
+        found = s.find(key, first, first + length, length);
+    }
+    if (!found) {
+        // Sized before converting, so a miss converts the value only once
+        length = exact_length(info, m_format);
+        if (length > sizeof local && length > buffer.size()) {
+            buffer.resize(length);
+            first = buffer.data();
+        }
+        exact_to_chars_result result = exact_to_chars(first, first + length, info, m_format);
+        // exact_length should always leave room. If it ever falls short, grow
+        // the buffer rather than write or keep part of the expansion.
+        while (result.ec != std::errc()) {
+            length = 2 * std::max(length, sizeof local);
+            buffer.resize(length);
+            first = buffer.data();
+            result = exact_to_chars(first, first + length, info, m_format);
+        }
+        s.add(key, first, result.ptr);
+        length = result.ptr - first;
+    }
+    os.write(first, length);
+}
+
+exact_cache_stats
+exact_cache::stats() const
+{
+    exact_cache_stats result = {0, 0, 0};
+    for (size_t i = 0; i < m_shard_count; ++i) {
+        std::lock_guard<std::mutex> lock(m_shards[i].mutex);
+        result.hits += m_shards[i].hits;
+        result.misses += m_shards[i].misses;
+        result.entries += m_shards[i].entries.size();
+    }
+    return result;
+}
@@ -0,0 +1,280 @@
+// Converts every Single bit pattern in a range, by default all 2^32 of
+// them, on every core. Finite values must parse back to the same bits;
+// infinities and NaNs must print their sign or payload. Reports values,
+// mismatches, and throughput by float_type.
+//
+//     exact-float-sweep [--first BITS] [--last BITS] [--threads N]
+#include "config.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/cstdfloat.hpp>
+#include <boost/program_options.hpp>
+#include "decimal-parse.h"
+#include "exact-float.h"
+
+namespace {
+
+// Patterns a worker takes from its range at a time
+std::uint64_t const block_size = 4096;
+// Mismatches each worker keeps for the report
+size_t const max_samples = 16;
+
+struct mismatch
+{
+    std::uint32_t bits;
+    std::string text;
+};
+
+// What one worker has seen
+struct tally
+{
+    std::uint64_t values[signaling_nan + 1];
+    std::uint64_t mismatches[signaling_nan + 1];
+    std::uint64_t bytes;
+    std::vector<mismatch> samples;
+
+    tally():
+        values(), mismatches(), bytes(0)
+    { }
+};
+
+// Patterns [next, end) not yet converted. The owner takes blocks from the
+// front; a worker whose own range is empty steals the back half.
+struct work_range
+{
+    std::mutex mutex;
+    std::uint64_t next;
+    std::uint64_t end;
+};
+
+class sweep
+{
+public:
+    sweep(std::uint64_t const first, std::uint64_t const last, unsigned const threads):
+        m_ranges(threads), m_tallies(threads)
+    {
+        // Equal shares to start with; stealing evens out the rest.
+        std::uint64_t const count = last - first;
+        for (unsigned i = 0; i < threads; ++i) {
+            m_ranges[i].next = first + count * i / threads;
+            m_ranges[i].end = first + count * (i + 1) / threads;
+        }
+    }
+
+    void run() {
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i < m_ranges.size(); ++i)
+            workers.emplace_back([this, i] { work(i); });
+        for (std::thread& worker: workers)
+            worker.join();
+    }
+
+    tally total() const {
+        tally result;
+        for (tally const& t: m_tallies) {
+            for (unsigned type = 0; type <= signaling_nan; ++type) {
+                result.values[type] += t.values[type];
+                result.mismatches[type] += t.mismatches[type];
+            }
+            result.bytes += t.bytes;
+            result.samples.insert(result.samples.end(), t.samples.begin(), t.samples.end());
+        }
+        std::sort(result.samples.begin(), result.samples.end(),
+                  [](mismatch const& a, mismatch const& b) { return a.bits < b.bits; });
+        if (result.samples.size() > max_samples)
+            result.samples.resize(max_samples);
+        return result;
+    }
+private:
+    void work(unsigned const self) {
+        // Counted locally so workers never share a cache line
+        tally t;
+        std::uint64_t first, last;
+        while (take(self, first, last) || steal(self, first, last)) {
+            for (std::uint64_t bits = first; bits != last; ++bits)
+                check(static_cast<std::uint32_t>(bits), t);
+        }
+        m_tallies[self] = std::move(t);
+    }
+
+    bool take(unsigned const self, std::uint64_t& first, std::uint64_t& last) {
+        work_range& range = m_ranges[self];
+        std::lock_guard<std::mutex> lock(range.mutex);
+        if (range.next == range.end)
+            return false;
+        first = range.next;
+        last = range.next = std::min(range.end, first + block_size);
+        return true;
+    }
+
+    // Move the back half of the fullest other range into this worker's.
+    bool steal(unsigned const self, std::uint64_t& first, std::uint64_t& last) {
+        for (;;) {
+            unsigned victim = self;
+            std::uint64_t most = 0;
+            for (unsigned i = 0; i < m_ranges.size(); ++i) {
+                if (i == self)
+                    continue;
+                std::lock_guard<std::mutex> lock(m_ranges[i].mutex);
+                if (m_ranges[i].end - m_ranges[i].next > most) {
+                    most = m_ranges[i].end - m_ranges[i].next;
+                    victim = i;
+                }
+            }
+            if (victim == self)
+                return false;
+            std::uint64_t stolen_first, stolen_last;
+            {
+                work_range& range = m_ranges[victim];
+                std::lock_guard<std::mutex> lock(range.mutex);
+                std::uint64_t const remaining = range.end - range.next;
+                // Someone else got there first; look again.
+                if (remaining == 0)
+                    continue;
+                stolen_last = range.end;
+                stolen_first = range.end = range.end - (remaining + 1) / 2;
+            }
+            {
+                work_range& range = m_ranges[self];
+                std::lock_guard<std::mutex> lock(range.mutex);
+                range.next = stolen_first;
+                range.end = stolen_last;
+            }
+            return take(self, first, last);
+        }
+    }
+
+    static void check(std::uint32_t const bits, tally& t) {
+        boost::float32_t value;
+        std::memcpy(&value, &bits, sizeof value);
+        FloatInfo const info(value);
+        // The smallest denormal needs the most room, about 150 characters.
+        char buffer[256];
+        exact_to_chars_result const written = exact_to_chars(buffer, buffer + sizeof buffer, info);
+        ++t.values[info.number_type];
+        t.bytes += written.ptr - buffer;
+
+        bool ok = written.ec == std::errc();
+        if (ok) {
+            std::string const text(buffer, written.ptr);
+            switch (info.number_type) {
+                case normal:
+                case zero:
+                case denormal: {
+                    decimal_value parsed;
+                    boost::float32_t back;
+                    ok = parsed.parse(text.data(), text.data() + text.size()) == std::errc()
+                        && parsed.to(back) == std::errc()
+                        && std::memcmp(&back, &value, sizeof value) == 0;
+                    break;
+                }
+                case infinity:
+                    ok = text == (info.negative ? "- Infinity" : "+ Infinity");
+                    break;
+                case quiet_nan:
+                    ok = text == "QNaN(" + std::to_string(info.mantissa) + ")";
+                    break;
+                case signaling_nan:
+                    ok = text == "SNaN(" + std::to_string(info.mantissa) + ")";
+                    break;
+                default:
+                    ok = false;
+                    break;
+            }
+        }
+        if (!ok) {
+            ++t.mismatches[info.number_type];
+            if (t.samples.size() < max_samples)
+                t.samples.push_back(mismatch{bits, std::string(buffer, written.ptr)});
+        }
+    }
+
+    std::vector<work_range> m_ranges;
+    std::vector<tally> m_tallies;
+};
+
+// A bit pattern in decimal, or in hex with 0x
+std::uint64_t
+parse_bits(std::string const& text, char const* const option)
+{
+    char* end;
+    errno = 0;
+    unsigned long long const bits = std::strtoull(text.c_str(), &end, 0);
+    if (text.empty() || *end != '\0' || errno == ERANGE || bits > 0xffffffffu) {
+        std::cerr << "--" << option << " must be a 32-bit pattern, such as 0x7f800000" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    return bits;
+}
+
+}
+
+int
+main(int argc, char const* argv[])
+{
+    namespace po = boost::program_options;
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help", "display program help")
+        ("first", po::value<std::string>()->default_value("0"), "first bit pattern to convert")
+        ("last", po::value<std::string>()->default_value("0xffffffff"), "last bit pattern to convert")
+        ("threads", po::value<unsigned>()->default_value(0), "convert on this many threads; 0 uses every core")
+        ;
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+    if (vm.count("help")) {
+        std::cout << desc << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    std::uint64_t const first = parse_bits(vm["first"].as<std::string>(), "first");
+    std::uint64_t const last = parse_bits(vm["last"].as<std::string>(), "last");
+    if (last < first) {
+        std::cerr << "--last can't be below --first" << std::endl;
+        return EXIT_FAILURE;
+    }
+    unsigned threads = vm["threads"].as<unsigned>();
+    if (threads == 0)
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    std::printf("Converting 0x%08llx through 0x%08llx on %u threads\n",
+                static_cast<unsigned long long>(first), static_cast<unsigned long long>(last), threads);
+    std::fflush(stdout);
+    auto const start = std::chrono::steady_clock::now();
+    sweep s(first, last + 1, threads);
+    s.run();
+    double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    tally const total = s.total();
+    std::uint64_t values = 0;
+    std::uint64_t mismatches = 0;
+    for (unsigned type = 0; type <= signaling_nan; ++type) {
+        values += total.values[type];
+        mismatches += total.mismatches[type];
+        if (total.values[type] == 0)
+            continue;
+        std::ostringstream name;
+        name << static_cast<float_type>(type);
+        std::printf("%-14s %12llu values %12llu mismatches\n", name.str().c_str(),
+                    static_cast<unsigned long long>(total.values[type]),
+                    static_cast<unsigned long long>(total.mismatches[type]));
+    }
+    for (mismatch const& m: total.samples)
+        std::printf("mismatch: 0x%08lx -> %s\n", static_cast<unsigned long>(m.bits), m.text.c_str());
+    std::printf("%llu values in %.2f s: %.2f M values/s, %.1f MB/s of text\n",
+                static_cast<unsigned long long>(values), seconds, values / seconds / 1e6,
+                total.bytes / seconds / 1e6);
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
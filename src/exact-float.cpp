@@ -1,18 +1,34 @@
 #undef _GLIBCXX_DEBUG
 #include "config.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
 #include <cstdint>
-#include <iomanip>
+#include <cstring>
 #include <ios>
 #include <iostream>
+#include <iterator>
 #include <limits>
 #include <locale>
-#include <map>
-#include <sstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
 #include <tuple>
 #include <type_traits>
+#include <vector>
 #include <boost/multiprecision/cpp_int.hpp>
+#ifdef USE_GMP
+#include <boost/multiprecision/gmp.hpp>
+#endif
 #include "exact-float.h"
+#include "arena.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace mp = boost::multiprecision;
 
@@ -41,8 +57,117 @@ std::ostream& operator<<(std::ostream& os, float_type const type)
     }
 }
 
+std::ostream& operator<<(std::ostream& os, exact_stage const stage)
+{
+    switch (stage)
+    {
+        case exact_stage::format:
+            return os << "format";
+        case exact_stage::length:
+            return os << "length";
+        case exact_stage::decompose:
+            return os << "decompose";
+        case exact_stage::normalize:
+            return os << "normalize";
+        case exact_stage::digits:
+            return os << "digits";
+        case exact_stage::grouping:
+            return os << "grouping";
+        case exact_stage::rounding:
+            return os << "rounding";
+        case exact_stage::output:
+            return os << "output";
+        default:
+            assert(false);
+    }
+}
+
 namespace {
 
+// The live counters behind exact_stats. Static storage starts them at zero
+// and disabled.
+struct stats_counters
+{
+    std::atomic<bool> enabled;
+    std::atomic<std::uint64_t> conversions[float_kinds][signaling_nan + 1];
+    std::atomic<std::uint64_t> stage_ns[exact_stages];
+    std::atomic<std::uint64_t> peak_limbs;
+    std::atomic<std::uint64_t> output_bytes;
+};
+
+stats_counters counters;
+
+bool
+stats_enabled()
+{
+    return counters.enabled.load(std::memory_order_relaxed);
+}
+
+// Charges the time between laps to stages. Does nothing unless stats were
+// enabled when it was made.
+class stage_clock
+{
+public:
+    stage_clock():
+        m_enabled(stats_enabled())
+    {
+        restart();
+    }
+    void lap(exact_stage const stage) {
+        if (!m_enabled)
+            return;
+        auto const now = clock::now();
+        auto const elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_last).count();
+        counters.stage_ns[static_cast<unsigned>(stage)].fetch_add(elapsed, std::memory_order_relaxed);
+        m_last = now;
+    }
+    // Skip time that an inner clock has already charged.
+    void restart() {
+        if (m_enabled)
+            m_last = clock::now();
+    }
+private:
+    using clock = std::chrono::steady_clock;
+    bool const m_enabled;
+    clock::time_point m_last;
+};
+
+void
+count_conversion(FloatInfo const& info, size_t const bytes)
+{
+    if (!stats_enabled())
+        return;
+    counters.conversions[static_cast<unsigned>(info.kind)][info.number_type].fetch_add(1, std::memory_order_relaxed);
+    counters.output_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+template <typename Integer>
+size_t
+limb_count(Integer const& Value)
+{
+    return Value.backend().size();
+}
+
+#ifdef USE_GMP
+size_t
+limb_count(mp::mpz_int const& Value)
+{
+    return mpz_size(Value.backend().data());
+}
+#endif
+
+template <typename Integer>
+void
+note_limbs(Integer const& Value)
+{
+    if (!stats_enabled())
+        return;
+    std::uint64_t const limbs = limb_count(Value);
+    std::uint64_t peak = counters.peak_limbs.load(std::memory_order_relaxed);
+    while (limbs > peak && !counters.peak_limbs.compare_exchange_weak(peak, limbs, std::memory_order_relaxed))
+        ;
+}
+
 struct tail_repeater
 {
     tail_repeater(std::string const& source):
@@ -59,70 +184,465 @@ private:
     std::string::const_iterator m_iterator;
 };
 
-void insert_thousands(std::ostream& os, std::string const& pattern, char const separator, std::string subject)
+// Number of separators grouping puts into a run of digits
+size_t
+count_separators(std::string const& pattern, size_t const digits)
 {
+    size_t count{0};
     if (!pattern.empty()) {
-        size_t const subject_size{subject.size()};
         tail_repeater next_count{pattern};
         char x = next_count();
-        for (unsigned total{0};
-             x > 0 && x != CHAR_MAX && total + x < subject_size;
+        for (size_t total{0};
+             x > 0 && x != CHAR_MAX && total + x < digits;
              x = next_count())
         {
             total += x;
-            subject.insert(subject_size - total, 1, separator);
+            ++count;
+        }
+    }
+    return count;
+}
+
+/**
+ * Spread out the digits starting at first to make room for separators. The
+ * caller provides room for count_separators() more characters. Working from
+ * the right, each digit moves once. */
+char*
+group_digits(char* const first, size_t const digits, std::string const& pattern, char const separator)
+{
+    size_t remaining = count_separators(pattern, digits);
+    char* const last = first + digits + remaining;
+    if (remaining > 0) {
+        tail_repeater next_count{pattern};
+        char const* source = first + digits;
+        char* dest = last;
+        for (; remaining > 0; --remaining) {
+            char const x = next_count();
+            dest = std::copy_backward(source - x, source, dest);
+            source -= x;
+            *--dest = separator;
+        }
+    }
+    return last;
+}
+
+/**
+ * What a stream's numpunct facet says, asked once per locale instead of once
+ * per value. The copy lives in the stream's pword slot and is dropped when
+ * the stream gets a new locale, copies another stream's format, or goes
+ * away; the next value asks again. */
+struct stream_punct
+{
+    char decimal_point;
+    char thousands_sep;
+    std::string grouping;
+
+    static stream_punct const& of(std::ios_base& os)
+    {
+        void*& slot = os.pword(index());
+        if (!slot) {
+            std::numpunct<char> const& punct = std::use_facet<std::numpunct<char>>(os.getloc());
+            slot = new stream_punct{punct.decimal_point(), punct.thousands_sep(), punct.grouping()};
+            // Copying formats copies the callbacks along with this flag, so
+            // it always says whether this stream's list has the callback.
+            long& registered = os.iword(index());
+            if (!registered) {
+                os.register_callback(forget, index());
+                registered = 1;
+            }
+        }
+        return *static_cast<stream_punct const*>(slot);
+    }
+private:
+    static int index()
+    {
+        static int const i = std::ios_base::xalloc();
+        return i;
+    }
+
+    static void forget(std::ios_base::event const event, std::ios_base& os, int const i)
+    {
+        void*& slot = os.pword(i);
+        // After copyfmt, the slot holds the other stream's pointer.
+        if (event != std::ios_base::copyfmt_event)
+            delete static_cast<stream_punct*>(slot);
+        slot = nullptr;
+    }
+};
+
+/**
+ * Powers of five, computed once on first use. Function-local statics are
+ * initialized thread-safely, so concurrent conversions can share them. A
+ * fixed-width integer keeps every power it can hold and looks them up
+ * directly. An unbounded integer keeps 5^(2^i) and multiplies together the
+ * ones that make up the requested exponent. */
+template <typename Integer, bool Bounded = std::numeric_limits<Integer>::is_bounded>
+struct powers_of_five;
+
+template <typename Integer>
+struct powers_of_five<Integer, true>
+{
+    static Integer const& get(unsigned const n)
+    {
+        static std::vector<Integer> const table = build();
+        return table.at(n);
+    }
+private:
+    static std::vector<Integer> build()
+    {
+        // log2(5) is just over 2.3219, so this many powers fit.
+        unsigned const count = std::numeric_limits<Integer>::digits * 10000u / 23220u;
+        std::vector<Integer> table;
+        table.reserve(count + 1);
+        table.push_back(1);
+        while (table.size() <= count)
+            table.push_back(table.back() * 5);
+        return table;
+    }
+};
+
+template <typename Integer>
+struct powers_of_five<Integer, false>
+{
+    static Integer get(unsigned n)
+    {
+        static std::vector<Integer> const squares = build();
+        if (n >> squares.size())
+            return mp::pow(Integer(5), n);
+        Integer result = 1;
+        for (auto i = 0u; n != 0; ++i, n >>= 1)
+            if (n & 1)
+                result *= squares[i];
+        return result;
+    }
+private:
+    static std::vector<Integer> build()
+    {
+        heap_scope const heap;
+        // Enough for the smallest Extended denormal, 2^-16445.
+        std::vector<Integer> squares{5};
+        while (squares.size() < 15)
+            squares.push_back(squares.back() * squares.back());
+        return squares;
+    }
+};
+
+template <typename Integer>
+auto
+power_of_five(unsigned const n) -> decltype(powers_of_five<Integer>::get(n))
+{
+    return powers_of_five<Integer>::get(n);
+}
+
+// Digits are produced in chunks that fit in a 64-bit word.
+unsigned const chunk_digits = 16;
+std::uint64_t const decimal_chunk = 10000000000000000u;
+// Below this many digits, peeling off one chunk at a time beats splitting.
+unsigned const split_threshold = chunk_digits << 6;
+
+/**
+ * Powers 10^(16 * 2^i), computed once on first use, with the reciprocals
+ * needed for Barrett reduction. Decimal conversion splits a number by the
+ * largest power below it and converts both halves recursively, and each split
+ * costs two multiplications instead of a long division. Reciprocals take a
+ * long division each, so they're only computed for levels that get used. A
+ * fixed-width integer only keeps the levels whose products it can hold. */
+template <typename Integer>
+struct decimal_powers
+{
+    struct level
+    {
+        Integer power;
+        Integer reciprocal; // floor(2^(2 * bits) / power)
+        unsigned bits;      // significant bits in power
+    };
+
+    static unsigned size()
+    {
+        return instance().levels.size();
+    }
+
+    static Integer const& power(unsigned const i)
+    {
+        return instance().levels[i].power;
+    }
+
+    static level const& at(unsigned const i)
+    {
+        table& t = instance();
+        level& result = t.levels[i];
+        std::call_once(t.ready[i], [&result] {
+            heap_scope const heap;
+            result.reciprocal = Integer(Integer(1) << (2 * result.bits)) / result.power;
+        });
+        return result;
+    }
+private:
+    struct table
+    {
+        std::vector<level> levels;
+        std::unique_ptr<std::once_flag[]> ready;
+    };
+
+    static table& instance()
+    {
+        static table t = build();
+        return t;
+    }
+
+    static table build()
+    {
+        heap_scope const heap;
+        // Enough to split the longest Extended expansion, about 16500 digits.
+        unsigned const max_levels = 11;
+        table result;
+        Integer power = decimal_chunk;
+        for (;;) {
+            unsigned const bits = mp::msb(power) + 1;
+            if (std::numeric_limits<Integer>::is_bounded
+                && 2 * bits + 2 > unsigned(std::numeric_limits<Integer>::digits))
+                break;
+            result.levels.push_back(level{power, Integer(), bits});
+            if (result.levels.size() == max_levels)
+                break;
+            power *= power;
         }
+        result.ready.reset(new std::once_flag[result.levels.size()]);
+        return result;
+    }
+};
+
+// Split Value into Value / power and Value % power for one level.
+template <typename Integer>
+void
+split_decimal(Integer const& Value, typename decimal_powers<Integer>::level const& divisor,
+              Integer& Quotient, Integer& Remainder)
+{
+    if (!Value.is_zero() && mp::msb(Value) >= 2 * divisor.bits) {
+        // Too large for the reciprocal; only happens beyond the cached levels.
+        mp::divide_qr(Value, divisor.power, Quotient, Remainder);
+        return;
+    }
+    // The estimate is at most two less than the true quotient.
+    Quotient = ((Value >> (divisor.bits - 1)) * divisor.reciprocal) >> (divisor.bits + 1);
+    Remainder = Value - Quotient * divisor.power;
+    while (Remainder >= divisor.power) {
+        Remainder -= divisor.power;
+        ++Quotient;
+    }
+}
+
+// Whether a backend's limbs are wide enough to divide by a chunk in place
+template <typename Backend>
+struct divides_by_limb: std::false_type {};
+
+template <unsigned MinBits, unsigned MaxBits, mp::cpp_integer_type Sign, mp::cpp_int_check_type Check, typename Allocator>
+struct divides_by_limb<mp::cpp_int_backend<MinBits, MaxBits, Sign, Check, Allocator>>:
+    std::integral_constant<bool, sizeof(mp::limb_type) >= sizeof(std::uint64_t)
+                                 && sizeof(mp::double_limb_type) == 2 * sizeof(mp::limb_type)>
+{};
+
+// Divide Value in place by 10^16 and return the remainder. The limb version
+// makes a single pass, where the generic one takes two.
+template <typename Integer>
+typename std::enable_if<divides_by_limb<typename Integer::backend_type>::value, std::uint64_t>::type
+divide_chunk(Integer& Value)
+{
+    auto& backend = Value.backend();
+    auto* const limbs = backend.limbs();
+    mp::double_limb_type remainder = 0;
+    for (auto i = backend.size(); i-- > 0;) {
+        remainder = (remainder << (sizeof(mp::limb_type) * CHAR_BIT)) | limbs[i];
+        limbs[i] = static_cast<mp::limb_type>(remainder / decimal_chunk);
+        remainder %= decimal_chunk;
     }
-    os << subject;
+    backend.normalize();
+    return static_cast<std::uint64_t>(remainder);
+}
+
+template <typename Integer>
+typename std::enable_if<!divides_by_limb<typename Integer::backend_type>::value, std::uint64_t>::type
+divide_chunk(Integer& Value)
+{
+    std::uint64_t const remainder = mp::integer_modulus(Value, decimal_chunk);
+    Value /= decimal_chunk;
+    return remainder;
+}
+
+#ifdef __SSE2__
+/**
+ * The eight digits of a value below 10^8, one per 16-bit lane, most
+ * significant first. The value splits into halves abcd and efgh, each half
+ * is copied into four lanes, and a multiply-high by scaled reciprocals of
+ * 1000, 100, 10, and 1 leaves a, ab, abc, abcd in them. Subtracting ten times
+ * each lane's left neighbor leaves a, b, c, d. */
+__m128i
+eight_digits(std::uint32_t const value)
+{
+    __m128i const abcdefgh = _mm_cvtsi32_si128(value);
+    // 0xd1b71759 / 2^45 is 1 / 10000, close enough for eight digits.
+    __m128i const abcd = _mm_srli_epi64(_mm_mul_epu32(abcdefgh, _mm_set1_epi32(0xd1b71759)), 45);
+    __m128i const efgh = _mm_sub_epi32(abcdefgh, _mm_mul_epu32(abcd, _mm_set1_epi32(10000)));
+    // Times four, which the reciprocals below expect
+    __m128i const halves = _mm_slli_epi64(_mm_unpacklo_epi16(abcd, efgh), 2);
+    __m128i const pairs = _mm_unpacklo_epi16(halves, halves);
+    __m128i const spread = _mm_unpacklo_epi32(pairs, pairs);
+    __m128i const reciprocals = _mm_setr_epi16(8389, 5243, 13108, static_cast<short>(0x8000),
+                                               8389, 5243, 13108, static_cast<short>(0x8000));
+    __m128i const shifts = _mm_setr_epi16(1 << 7, 1 << 11, 1 << 13, static_cast<short>(1 << 15),
+                                          1 << 7, 1 << 11, 1 << 13, static_cast<short>(1 << 15));
+    __m128i const prefixes = _mm_mulhi_epu16(_mm_mulhi_epu16(spread, reciprocals), shifts);
+    __m128i const tens = _mm_slli_epi64(_mm_mullo_epi16(prefixes, _mm_set1_epi16(10)), 16);
+    return _mm_sub_epi16(prefixes, tens);
 }
 
-// Print Man * 10^DecExp
+// Write the 16 digits, with leading zeros, of a value below 10^16.
 void
-build_result(std::ostream& os, int DecExp, mp::cpp_int Man, bool negative)
+sixteen_digits(std::uint64_t const value, char* const out)
 {
-    mp::cpp_int const Factor = DecExp < 0
-        ? mp::pow(mp::cpp_int(10), -DecExp)
-        : mp::cpp_int(1);
-    mp::cpp_int Remainder;
-    mp::divide_qr(Man, Factor, Man, Remainder);
+    __m128i const high = eight_digits(static_cast<std::uint32_t>(value / 100000000));
+    __m128i const low = eight_digits(static_cast<std::uint32_t>(value % 100000000));
+    __m128i const digits = _mm_add_epi8(_mm_packus_epi16(high, low), _mm_set1_epi8('0'));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), digits);
+}
+#endif
 
-    std::ostringstream result;
-    std::numpunct<char> const& punct = std::use_facet<std::numpunct<char>>(os.getloc());
-    insert_thousands(result, punct.grouping(), punct.thousands_sep(), boost::lexical_cast<std::string>(Man));
-    auto const flags = os.flags();
-    if (!Remainder.is_zero() || flags & os.showpoint) {
-        result << punct.decimal_point();
-        result << std::setw(-DecExp) << std::setfill('0') << Remainder;
+// Write exactly width digits of a value below 10^width.
+char*
+write_chunk(std::uint64_t value, unsigned const width, char* out)
+{
+#ifdef __SSE2__
+    // Whole chunks go straight to the output. Shorter runs of eight or more
+    // digits, such as a leading chunk, are expanded on the side; anything
+    // shorter, such as an exponent, is quicker one digit at a time.
+    if (width == chunk_digits) {
+        sixteen_digits(value, out);
+        return out + width;
+    }
+    if (width >= 8) {
+        char digits[chunk_digits];
+        sixteen_digits(value, digits);
+        std::memcpy(out, digits + chunk_digits - width, width);
+        return out + width;
     }
+#endif
+    for (char* p = out + width; p != out; value /= 10)
+        *--p = '0' + value % 10;
+    return out + width;
+}
+
+// Write exactly width digits, with leading zeros, of a value below 10^width.
+template <typename Integer>
+char*
+write_padded_digits(Integer const& Value, unsigned const width, char* out)
+{
+    if (width <= chunk_digits)
+        return write_chunk(Value.template convert_to<std::uint64_t>(), width, out);
+    if (width <= split_threshold) {
+        // Peel 16-digit chunks off the bottom; dividing by a single limb is
+        // cheaper than a split at this size.
+        Integer Quotient = Value;
+        char* p = out + width;
+        for (; p - out > chunk_digits; p -= chunk_digits) {
+            write_chunk(divide_chunk(Quotient), chunk_digits, p - chunk_digits);
+        }
+        write_chunk(Quotient.template convert_to<std::uint64_t>(), p - out, out);
+        return out + width;
+    }
+    using powers = decimal_powers<Integer>;
+    auto level = 0u;
+    while (level + 1 < powers::size() && (chunk_digits << (level + 1)) < width)
+        ++level;
+    Integer Quotient, Remainder;
+    split_decimal(Value, powers::at(level), Quotient, Remainder);
+    out = write_padded_digits(Quotient, width - (chunk_digits << level), out);
+    return write_padded_digits(Remainder, chunk_digits << level, out);
+}
+
+// An upper bound on the number of decimal digits in Value
+template <typename Integer>
+size_t
+max_digits(Integer const& Value)
+{
+    return Value.is_zero() ? 1 : (mp::msb(Value) + 1) * 30103 / 100000 + 1;
+}
+
+/**
+ * The number of decimal digits in Value. The estimate is at most one too
+ * high, and comparing against 10^(n - 1) = 5^(n - 1) * 2^(n - 1) settles
+ * it. */
+template <typename Integer>
+size_t
+decimal_digits(Integer const& Value)
+{
+    size_t digits = max_digits(Value);
+    while (digits > 1 && Integer(Value >> (digits - 1)) < power_of_five<Integer>(digits - 1))
+        --digits;
+    return digits;
+}
+
+// Write the digits of Value with no leading zeros.
+template <typename Integer>
+char*
+write_digits(Integer const& Value, char* out)
+{
+    return write_padded_digits(Value, decimal_digits(Value), out);
+}
+
+// Write Man * 10^DecExp
+// Dividing by 10^n is the same as shifting right by n and then dividing by
+// 5^n, which keeps the divisor about half the size of the power of ten.
+// With fixed set, always write -DecExp fraction digits instead of only the
+// ones the value needs.
+template <typename Integer>
+exact_to_chars_result
+build_result(char* first, char* const last, int DecExp, Integer Man, bool negative, exact_format const& format,
+             bool const fixed = false)
+{
+    stage_clock clock;
+    Integer Remainder;
+    if (DecExp < 0) {
+        unsigned const shift = -DecExp;
+        Integer const low_bits = Man & ((Integer(1) << shift) - 1);
+        mp::divide_qr(Integer(Man >> shift), Integer(power_of_five<Integer>(shift)), Man, Remainder);
+        Remainder = (Remainder << shift) | low_bits;
+    }
+
+    size_t const whole_digits = decimal_digits(Man);
+    size_t const separators = count_separators(format.grouping, whole_digits);
+    bool const include_sign{negative || format.showpos};
+    bool const include_point{(fixed ? DecExp < 0 : !Remainder.is_zero()) || format.showpoint};
+    size_t const fraction_digits = !include_point ? 0 : fixed ? -DecExp : std::max(-DecExp, 1);
+    if (size_t(last - first) < include_sign + whole_digits + separators + include_point + fraction_digits)
+        return {last, std::errc::value_too_large};
 
-    size_t const target_width = os.width(0);
-    bool const include_sign{negative || flags & os.showpos};
-    size_t const result_width = result.str().size() + include_sign;
-    size_t const padding_width = result_width >= target_width ? 0 : target_width - result_width;
-    if ((flags & os.adjustfield) == 0 || flags & os.right)
-        os << std::string(padding_width, os.fill());
-    char const sign = negative ? '-' : '+';
     if (include_sign)
-        os << sign;
-    if (flags & os.internal)
-        os << std::string(padding_width, os.fill());
-    os << result.str();
-    if (flags & os.left)
-        os << std::string(padding_width, os.fill());
+        *first++ = negative ? '-' : '+';
+    write_padded_digits(Man, whole_digits, first);
+    clock.lap(exact_stage::digits);
+    first = group_digits(first, whole_digits, format.grouping, format.thousands_sep);
+    clock.lap(exact_stage::grouping);
+    if (include_point) {
+        *first++ = format.decimal_point;
+        first = write_padded_digits(Remainder, fraction_digits, first);
+    }
+    clock.lap(exact_stage::digits);
+    return {first, std::errc()};
 }
 
 /**
  * Reduce mantissa to minimum number of bits
  * That is, while mantissa is even, divide by 2 and increment binary
  * exponent. Stop if the exponent isn't negative. */
-std::tuple<mp::cpp_int, int /*BinExp*/>
-minimize_mantissa(mp::cpp_int const& Man, int const BinExp)
+template <typename Integer>
+std::tuple<Integer, int /*BinExp*/>
+minimize_mantissa(Integer const& Man, int const BinExp)
 {
     auto const idx = Man.is_zero() ? 0 : mp::lsb(Man);
     int const adjustment = std::min<int>(idx, -BinExp);
     if (adjustment <= 0)
         return std::make_tuple(Man, BinExp);
-    return std::make_tuple(Man >> adjustment, BinExp + adjustment);
+    return std::make_tuple(Integer(Man >> adjustment), BinExp + adjustment);
 }
 
 /**
@@ -131,64 +651,410 @@ minimize_mantissa(mp::cpp_int const& Man, int const BinExp)
  * as multiply by 5 and increment of the BinExp exponent. Also note
  * that a multiply by 5 adds two or three bits to the number of
  * mantissa bits. */
-std::tuple<mp::cpp_int, int /*BinExp*/, int/*DecExp*/>
-remove_fraction(mp::cpp_int Man, int const BinExp)
+template <typename Integer>
+std::tuple<Integer, int /*BinExp*/, int/*DecExp*/>
+remove_fraction(Integer Man, int const BinExp)
 {
     if (BinExp >= 0)
         return std::make_tuple(Man, BinExp, 0);
 
-    return std::make_tuple(Man * mp::pow(mp::cpp_int(5), -BinExp), 0, BinExp);
+    return std::make_tuple(Integer(Man * power_of_five<Integer>(-BinExp)), 0, BinExp);
 }
 
 // Finish reducing BinExp to 0 by shifting mantissa up
-mp::cpp_int
-reduce_binary_exponent(mp::cpp_int Man, int BinExp)
+template <typename Integer>
+Integer
+reduce_binary_exponent(Integer Man, int BinExp)
 {
     assert(BinExp >= 0);
     return Man << BinExp;
 }
 
+// Value = Mantissa * 2^BinExp * 10^DecExp
+template <typename Integer>
+exact_to_chars_result
+binary_to_decimal(char* first, char* last, Integer Man, int BinExp, bool negative, exact_format const& format)
+{
+    stage_clock clock;
+    std::tie(Man, BinExp) = minimize_mantissa(Man, BinExp);
+
+    int DecExp;
+    std::tie(Man, BinExp, DecExp) = remove_fraction(Man, BinExp);
+    assert(DecExp <= 0);
+
+    Man = reduce_binary_exponent(Man, BinExp);
+    note_limbs(Man);
+    clock.lap(exact_stage::normalize);
+
+    return build_result(first, last, DecExp, Man, negative, format);
+}
+
+// Round the larger bit count up to a whole number of 64-bit limbs
+constexpr unsigned
+whole_limbs(int integer_bits, int denormal_bits)
+{
+    return ((integer_bits > denormal_bits ? integer_bits : denormal_bits) + 63) / 64 * 64;
+}
+
+/**
+ * Number of bits needed for the exact expansion of any finite float type. The
+ * largest integer value needs max_exponent bits. The smallest denormal is
+ * 2^(min_exponent - digits), which becomes its mantissa times
+ * 5^(digits - min_exponent); log2(5) is just under 2.322. The result is
+ * rounded up to whole limbs. */
+constexpr unsigned
+exact_bits(int digits, int min_exponent, int max_exponent)
+{
+    return whole_limbs(max_exponent, digits + (digits - min_exponent) * 2322 / 1000 + 1);
+}
+
+// An unsigned integer that lives entirely on the stack. Conversions using it
+// never allocate.
+template <typename Float, unsigned Bits = exact_bits(std::numeric_limits<Float>::digits,
+                                                     std::numeric_limits<Float>::min_exponent,
+                                                     std::numeric_limits<Float>::max_exponent)>
+using fixed_uint = mp::number<
+    mp::cpp_int_backend<Bits, Bits, mp::unsigned_magnitude, mp::unchecked, void>,
+    mp::et_off>;
+
+// An unbounded integer for temporaries. Inside an arena_scope its storage
+// comes from the thread's arena instead of the global heap.
+using arena_int = mp::number<
+    mp::cpp_int_backend<0, 0, mp::signed_magnitude, mp::unchecked, arena_allocator<mp::limb_type>>>;
+
+template <typename Integer>
+exact_to_chars_result
+write_decimal(char* first, char* last, mp::cpp_int const& Value, int BinExp, bool negative, exact_format const& format)
+{
+    return binary_to_decimal(first, last, Integer(Value), BinExp, negative, format);
+}
+
+#ifdef USE_GMP
+// Bits in the whole number an Extended value expands to, above which GMP's
+// subquadratic multiplication and division outrun cpp_int. Below it, GMP's
+// setup costs more than it saves.
+unsigned const gmp_threshold = 4096;
+
+// Whether write_extended converts a value with binary exponent BinExp with
+// GMP
+bool
+extended_uses_gmp(int const BinExp)
+{
+    // Each negative power of two becomes a power of five, about 2.32 bits.
+    unsigned const bits = BinExp >= 0 ? BinExp : -BinExp * 2322 / 1000;
+    return bits >= gmp_threshold;
+}
+#endif
+
+// write_decimal for Extended values, which range from a few digits to
+// thousands
+exact_to_chars_result
+write_extended(char* first, char* last, mp::cpp_int const& Value, int BinExp, bool negative,
+               exact_format const& format)
+{
+#ifdef USE_GMP
+    if (extended_uses_gmp(BinExp))
+        return write_decimal<mp::mpz_int>(first, last, Value, BinExp, negative, format);
+#endif
+    return write_decimal<arena_int>(first, last, Value, BinExp, negative, format);
+}
+
+/**
+ * Number of characters build_result writes for Value * 2^BinExp, found
+ * without converting. Once the trailing zero bits are gone, an odd mantissa
+ * times 2^-n has exactly n fraction digits. The whole digits come from a
+ * logarithm, which is only checked exactly when it lands too close to an
+ * integer to trust. */
+size_t
+decimal_length(mp::cpp_int const& Value, int const BinExp, bool const negative, exact_format const& format)
+{
+    size_t whole_digits = 1;
+    size_t fraction_digits = 0;
+    if (!Value.is_zero()) {
+        unsigned const zeros = mp::lsb(Value);
+        mp::cpp_int const odd = Value >> zeros;
+        int const exponent = BinExp + int(zeros);
+        if (exponent < 0)
+            fraction_digits = -exponent;
+
+        // Only the top 64 bits of the mantissa matter to the logarithm.
+        unsigned const bits = mp::msb(odd) + 1;
+        unsigned const dropped = bits > 64 ? bits - 64 : 0;
+        long double const log = std::log10(static_cast<long double>(mp::cpp_int(odd >> dropped).convert_to<std::uint64_t>()))
+            + (exponent + int(dropped)) * 0.301029995663981195214L;
+        long double const nearest = std::floor(log + 0.5L);
+        if (std::fabs(log - nearest) < 1e-9L) {
+            mp::cpp_int const whole = exponent >= 0 ? mp::cpp_int(odd << exponent) : mp::cpp_int(odd >> -exponent);
+            whole_digits = decimal_digits(whole);
+        } else if (log > 0) {
+            whole_digits = static_cast<size_t>(std::floor(log)) + 1;
+        }
+    }
+
+    bool const include_sign{negative || format.showpos};
+    bool const include_point{fraction_digits > 0 || format.showpoint};
+    return include_sign
+        + whole_digits + count_separators(format.grouping, whole_digits)
+        + include_point + std::max<size_t>(fraction_digits, include_point);
+}
+
+/**
+ * Man * 2^BinExp / 10^DecExp, rounded half to even. Only this quotient is
+ * formed, so the cost follows the number of digits kept rather than the
+ * length of the exact expansion. */
+mp::cpp_int
+scaled_quotient(mp::cpp_int const& Man, int const BinExp, int const DecExp)
+{
+    // 10^DecExp is 2^DecExp * 5^DecExp; the twos join the binary exponent.
+    int const shift = BinExp - DecExp;
+    mp::cpp_int numerator = Man;
+    if (DecExp < 0)
+        numerator *= power_of_five<mp::cpp_int>(-DecExp);
+    if (shift >= 0)
+        numerator <<= shift;
+    if (DecExp <= 0 && shift >= 0)
+        return numerator;
+
+    mp::cpp_int quotient;
+    bool half, above;
+    if (DecExp <= 0) {
+        // Dividing by a power of two only needs the bits shifted out.
+        unsigned const bits = -shift;
+        quotient = numerator >> bits;
+        half = mp::bit_test(numerator, bits - 1);
+        above = half && !numerator.is_zero() && mp::lsb(numerator) < bits - 1;
+    } else {
+        mp::cpp_int denominator = power_of_five<mp::cpp_int>(DecExp);
+        if (shift < 0)
+            denominator <<= -shift;
+        mp::cpp_int remainder;
+        mp::divide_qr(numerator, denominator, quotient, remainder);
+        remainder <<= 1;
+        half = remainder >= denominator;
+        above = remainder > denominator;
+    }
+    if (above || (half && mp::bit_test(quotient, 0)))
+        ++quotient;
+    return quotient;
+}
+
+/**
+ * Round Man * 2^BinExp to format.precision digits after the decimal point,
+ * as Digits * 10^DecExp. For scientific notation, Digits has exactly
+ * precision + 1 digits unless the value is zero. */
+mp::cpp_int
+round_decimal(mp::cpp_int const& Man, int const BinExp, exact_format const& format, int& DecExp)
+{
+    int const precision = std::max(format.precision, 0);
+    if (format.notation == exact_notation::fixed || Man.is_zero()) {
+        DecExp = -precision;
+        return scaled_quotient(Man, BinExp, DecExp);
+    }
+
+    // Estimate the leading digit's position from the top bits, then correct
+    // it against the quotient, which must land in [10^precision, 10^(precision+1)).
+    unsigned const bits = mp::msb(Man) + 1;
+    unsigned const dropped = bits > 64 ? bits - 64 : 0;
+    long double const log = std::log10(static_cast<long double>(mp::cpp_int(Man >> dropped).convert_to<std::uint64_t>()))
+        + (BinExp + int(dropped)) * 0.301029995663981195214L;
+    DecExp = static_cast<int>(std::floor(log)) - precision;
+    mp::cpp_int const low = mp::cpp_int(power_of_five<mp::cpp_int>(precision)) << precision;
+    mp::cpp_int const high = low * 10;
+    for (;;) {
+        mp::cpp_int const digits = scaled_quotient(Man, BinExp, DecExp);
+        if (digits >= high)
+            ++DecExp;
+        else if (digits < low)
+            --DecExp;
+        else
+            return digits;
+    }
+}
+
+// The exponent of scientific notation has at least two digits.
+size_t
+exponent_digits(int const exponent)
+{
+    size_t digits = 2;
+    for (unsigned e = std::abs(exponent); e >= 100; e /= 10)
+        ++digits;
+    return digits;
+}
+
+// Write Man * 2^BinExp rounded to the format's notation and precision.
+exact_to_chars_result
+write_rounded(char* const first, char* const last, mp::cpp_int const& Man, int const BinExp, bool const negative,
+              exact_format const& format)
+{
+    stage_clock clock;
+    int DecExp;
+    mp::cpp_int const digits = round_decimal(Man, BinExp, format, DecExp);
+    note_limbs(digits);
+    clock.lap(exact_stage::rounding);
+    if (format.notation == exact_notation::fixed)
+        return build_result(first, last, DecExp, digits, negative, format, true);
+
+    int const exponent = DecExp + std::max(format.precision, 0);
+    size_t const exponent_width = 2 + exponent_digits(exponent);
+    if (size_t(last - first) < exponent_width)
+        return {last, std::errc::value_too_large};
+    auto result = build_result(first, last - exponent_width, DecExp - exponent, digits, negative, format, true);
+    if (result.ec != std::errc())
+        return {last, result.ec};
+    *result.ptr++ = format.uppercase ? 'E' : 'e';
+    *result.ptr++ = exponent < 0 ? '-' : '+';
+    result.ptr = write_chunk(std::abs(exponent), exponent_digits(exponent), result.ptr);
+    return result;
+}
+
+size_t
+rounded_length(mp::cpp_int const& Man, int const BinExp, bool const negative, exact_format const& format)
+{
+    int DecExp;
+    mp::cpp_int const digits = round_decimal(Man, BinExp, format, DecExp);
+    size_t const fraction_digits = std::max(format.precision, 0);
+    size_t whole_digits = 1;
+    size_t exponent_width = 0;
+    if (format.notation == exact_notation::fixed) {
+        size_t const all_digits = decimal_digits(digits);
+        if (all_digits > fraction_digits)
+            whole_digits = all_digits - fraction_digits;
+    } else {
+        int const exponent = DecExp + std::max(format.precision, 0);
+        exponent_width = 2 + exponent_digits(exponent);
+    }
+    bool const include_sign{negative || format.showpos};
+    bool const include_point{fraction_digits > 0 || format.showpoint};
+    return include_sign
+        + whole_digits + count_separators(format.grouping, whole_digits)
+        + include_point + fraction_digits + exponent_width;
+}
+
+/**
+ * Write [first, last) to the stream, padded to the stream's width. Internal
+ * padding goes after the sign of a number; other text is padded the way a
+ * string would be. */
+void
+write_padded(std::ostream& os, char const* first, char const* const last, bool const numeric)
+{
+    size_t const target_width = os.width(0);
+    size_t const result_width = last - first;
+    size_t const padding_width = result_width >= target_width ? 0 : target_width - result_width;
+    auto const adjust = os.flags() & os.adjustfield;
+    if (numeric && adjust == os.internal && first != last && (*first == '-' || *first == '+'))
+        os.put(*first++);
+    if (adjust != os.left)
+        std::fill_n(std::ostreambuf_iterator<char>(os), padding_width, os.fill());
+    os.write(first, last - first);
+    if (adjust == os.left)
+        std::fill_n(std::ostreambuf_iterator<char>(os), padding_width, os.fill());
+}
+
+exact_to_chars_result
+write_text(char* const first, char* const last, char const* text)
+{
+    size_t const length = std::strlen(text);
+    if (size_t(last - first) < length)
+        return {last, std::errc::value_too_large};
+    return {std::copy(text, text + length, first), std::errc()};
+}
+
+// Write a NaN's kind and payload, e.g. "QNaN(123)"
+exact_to_chars_result
+write_nan(char* first, char* const last, char const* kind, mp::cpp_int const& payload)
+{
+    size_t const digits = decimal_digits(payload);
+    size_t const length = std::strlen(kind) + 1 + digits + 1;
+    if (size_t(last - first) < length)
+        return {last, std::errc::value_too_large};
+    first = std::copy(kind, kind + std::strlen(kind), first);
+    *first++ = '(';
+    first = write_padded_digits(payload, digits, first);
+    *first++ = ')';
+    return {first, std::errc()};
+}
+
+size_t
+nan_length(char const* kind, mp::cpp_int const& payload)
+{
+    return std::strlen(kind) + 1 + decimal_digits(payload) + 1;
+}
+
 } // namespace
 
-std::map<std::type_index, float_traits> const float_trait_map {
+float_descriptor const float_descriptors[] {
 #ifdef BOOST_FLOAT80_C
-    { typeid(boost::float80_t), {
-        80, std::numeric_limits<boost::float80_t>::digits, false, std::numeric_limits<boost::float80_t>::max_exponent, "an", "Extended"
-    }},
+    {
+        float_traits<boost::float80_t>::bits, float_traits<boost::float80_t>::digits,
+        float_traits<boost::float80_t>::implied_one, float_traits<boost::float80_t>::max_exponent, "an", "Extended",
+        write_extended
+    },
 #endif
 #ifdef BOOST_FLOAT64_C
-    { typeid(boost::float64_t), {
-        64, std::numeric_limits<boost::float64_t>::digits, true, std::numeric_limits<boost::float64_t>::max_exponent, "a", "Double"
-    }},
+    {
+        float_traits<boost::float64_t>::bits, float_traits<boost::float64_t>::digits,
+        float_traits<boost::float64_t>::implied_one, float_traits<boost::float64_t>::max_exponent, "a", "Double",
+        write_decimal<fixed_uint<boost::float64_t>>
+    },
 #endif
 #ifdef BOOST_FLOAT32_C
-    { typeid(boost::float32_t), {
-        32, std::numeric_limits<boost::float32_t>::digits, true, std::numeric_limits<boost::float32_t>::max_exponent, "a", "Single"
-    }},
+    {
+        float_traits<boost::float32_t>::bits, float_traits<boost::float32_t>::digits,
+        float_traits<boost::float32_t>::implied_one, float_traits<boost::float32_t>::max_exponent, "a", "Single",
+        write_decimal<fixed_uint<boost::float32_t>>
+    },
 #endif
 };
 
+float_kind
+kind_of(std::type_index const type)
+{
+#ifdef BOOST_FLOAT80_C
+    if (type == typeid(boost::float80_t))
+        return float_kind::float80;
+#endif
+#ifdef BOOST_FLOAT64_C
+    if (type == typeid(boost::float64_t))
+        return float_kind::float64;
+#endif
+#ifdef BOOST_FLOAT32_C
+    if (type == typeid(boost::float32_t))
+        return float_kind::float32;
+#endif
+    throw std::out_of_range(std::string("not a supported float type: ") + type.name());
+}
+
 float_type
-get_float_type(mp::cpp_int exponent, mp::cpp_int mantissa, std::type_index type)
+get_float_type(std::uint32_t const exponent, std::uint64_t const mantissa, float_kind const kind)
 {
-    float_traits const& traits = float_trait_map.at(type);
-    auto const exponent_mask = (mp::cpp_int(1) << traits.exponent_bits()) - 1;
-    if (exponent == exponent_mask) {
-        if (mantissa.is_zero())
+    float_descriptor const& traits = describe(kind);
+    unsigned const top = traits.mantissa_bits() - 1;
+    // Mantissa bits below the given one
+    auto const below = [mantissa](unsigned const bit) {
+        return mantissa & ((std::uint64_t(1) << bit) - 1);
+    };
+    if (exponent == (1u << traits.exponent_bits()) - 1) {
+        if (mantissa == 0)
             return infinity;
-        bool const top_bit = mp::bit_test(mantissa, traits.mantissa_bits() - 1);
+        bool const top_bit = mantissa >> top & 1;
         if (traits.implied_one)
             return top_bit ? quiet_nan : signaling_nan;
         // From here down, we know it's a float80_t
         if (!top_bit)
             return signaling_nan;
-        if (mp::bit_test(mantissa, traits.mantissa_bits() - 2))
-            return mp::lsb(mantissa) < traits.mantissa_bits() - 2 ? quiet_nan : indefinite;
-        return mp::lsb(mantissa) < traits.mantissa_bits() - 1 ? signaling_nan : infinity;
-    } else if (exponent.is_zero())
-        return mantissa.is_zero() ? zero : denormal;
+        if (mantissa >> (top - 1) & 1)
+            return below(top - 1) ? quiet_nan : indefinite;
+        return below(top) ? signaling_nan : infinity;
+    } else if (exponent == 0)
+        return mantissa == 0 ? zero : denormal;
     else
-        return (!traits.implied_one && !mp::bit_test(mantissa, traits.mantissa_bits() - 1)) ? denormal : normal;
+        return (!traits.implied_one && !(mantissa >> top & 1)) ? denormal : normal;
+}
+
+float_type
+get_float_type(mp::cpp_int exponent, mp::cpp_int mantissa, std::type_index type)
+{
+    return get_float_type(exponent.convert_to<std::uint32_t>(), mantissa.convert_to<std::uint64_t>(), kind_of(type));
 }
 
 bool FloatInfo::operator==(FloatInfo const& other) const
@@ -199,50 +1065,357 @@ bool FloatInfo::operator==(FloatInfo const& other) const
         && number_type == other.number_type;
 }
 
-// Value = Mantissa * 2^BinExp * 10^DecExp
-void
-FloatingBinPointToDecStr(std::ostream& os, mp::cpp_int Value, int BinExp, bool negative)
+exact_format::exact_format(std::ostream& os)
 {
-    mp::cpp_int Man = Value;
-
-    std::tie(Man, BinExp) = minimize_mantissa(Man, BinExp);
-
-    int DecExp;
-    std::tie(Man, BinExp, DecExp) = remove_fraction(Man, BinExp);
-    assert(DecExp <= 0);
+    stream_punct const& punct = stream_punct::of(os);
+    decimal_point = punct.decimal_point;
+    thousands_sep = punct.thousands_sep;
+    grouping = punct.grouping;
+    showpos = os.flags() & os.showpos;
+    showpoint = os.flags() & os.showpoint;
+    uppercase = os.flags() & os.uppercase;
+    // Both bits together mean hexfloat, which has no exact decimal meaning;
+    // print the exact expansion as for the default.
+    switch (os.flags() & os.floatfield) {
+        case std::ios_base::fixed:
+            notation = exact_notation::fixed;
+            break;
+        case std::ios_base::scientific:
+            notation = exact_notation::scientific;
+            break;
+        default:
+            notation = exact_notation::exact;
+            break;
+    }
+    precision = os.precision() < 0 ? 6 : static_cast<int>(os.precision());
+}
 
-    Man = reduce_binary_exponent(Man, BinExp);
+void
+FloatInfo::decompose(mp::cpp_int& value, int& bin_exp) const
+{
+    // The integer bit is either explicit, or implied for normal numbers.
+    float_descriptor const& traits = describe(kind);
+    unsigned const fraction_bits = traits.digits - 1;
+    value = mantissa;
+    if (number_type == normal && traits.implied_one)
+        mp::bit_set(value, fraction_bits);
+    bin_exp = value.is_zero()
+        ? 0
+        : std::max<int>(exponent, 1) - int(traits.exponent_bias()) - int(fraction_bits);
+}
 
-    build_result(os, DecExp, Man, negative);
+void
+FloatingBinPointToDecStr(std::ostream& os, mp::cpp_int Value, int BinExp, bool negative)
+{
+    stage_clock clock;
+    exact_format const format(os);
+    clock.lap(exact_stage::format);
+    std::vector<char> buffer(decimal_length(Value, BinExp, negative, format));
+    clock.lap(exact_stage::length);
+    auto const result = binary_to_decimal(buffer.data(), buffer.data() + buffer.size(),
+                                          Value, BinExp, negative, format);
+    clock.restart();
+    write_padded(os, buffer.data(), result.ptr, true);
+    clock.lap(exact_stage::output);
 }
 
-std::ostream&
-operator<<(std::ostream& os, FloatInfo const& info)
+exact_to_chars_result
+FloatInfo::write(char* first, char* last, exact_format const& format, mp::cpp_int& value) const
 {
-    switch (info.number_type) {
-        case normal: {
-            unsigned const mantissa_offset = info.traits.mantissa_bits() - 1 + info.traits.implied_one;
-            mp::cpp_int const full_mantissa = (mp::cpp_int(1) << mantissa_offset) | info.mantissa;
-            mp::cpp_int const adjusted_exponent = info.exponent - info.traits.exponent_bias() - mantissa_offset;
-            FloatingBinPointToDecStr(os, full_mantissa, adjusted_exponent.convert_to<int>(), info.negative);
-            return os;
+    switch (number_type) {
+        case normal:
+        case zero:
+        case denormal: {
+            // The conversion's temporaries all go when it's done.
+            arena_scope const scope;
+            stage_clock clock;
+            int bin_exp;
+            decompose(value, bin_exp);
+            clock.lap(exact_stage::decompose);
+            if (format.notation != exact_notation::exact)
+                return write_rounded(first, last, value, bin_exp, negative, format);
+            return describe(kind).write_decimal(first, last, value, bin_exp, negative, format);
         }
+        case indefinite:
+            return write_text(first, last, "Indefinite");
+        case infinity:
+            return write_text(first, last, negative ? "- Infinity" : "+ Infinity");
+        case quiet_nan:
+            return write_nan(first, last, "QNaN", mantissa);
+        case signaling_nan:
+            return write_nan(first, last, "SNaN", mantissa);
+        default:
+            return write_text(first, last, "unknown-number-type");
+    }
+}
+
+size_t
+FloatInfo::length(exact_format const& format, mp::cpp_int& value) const
+{
+    switch (number_type) {
+        case normal:
         case zero:
-            FloatingBinPointToDecStr(os, 0, 1, info.negative);
-            return os;
-        case denormal:
-            // TODO!
-            FloatingBinPointToDecStr(os, info.mantissa, -info.traits.exponent_bias() - (info.traits.mantissa_bits() - 2), info.negative);
-            return os;
+        case denormal: {
+            int bin_exp;
+            decompose(value, bin_exp);
+            if (format.notation != exact_notation::exact)
+                return rounded_length(value, bin_exp, negative, format);
+            return decimal_length(value, bin_exp, negative, format);
+        }
         case indefinite:
-            return os << "Indefinite";
+            return std::strlen("Indefinite");
         case infinity:
-            return os << (info.negative ? "- Infinity" : "+ Infinity");
+            return std::strlen("+ Infinity");
         case quiet_nan:
-            return os << boost::format("QNaN(%d)") % info.mantissa;
+            return nan_length("QNaN", mantissa);
         case signaling_nan:
-            return os << boost::format("SNaN(%d)") % info.mantissa;
+            return nan_length("SNaN", mantissa);
         default:
-            return os << "unknown-number-type";
+            return std::strlen("unknown-number-type");
+    }
+}
+
+exact_to_chars_result
+exact_to_chars(char* first, char* last, FloatInfo const& info, exact_format const& format)
+{
+    mp::cpp_int value;
+    auto const result = info.write(first, last, format, value);
+    if (result.ec == std::errc())
+        count_conversion(info, result.ptr - first);
+    return result;
+}
+
+size_t
+exact_length(FloatInfo const& info, exact_format const& format)
+{
+    mp::cpp_int value;
+    return info.length(format, value);
+}
+
+// Converts arrays of one float type, keeping the storage of one scratch
+// integer from one value to the next.
+struct batch_converter
+{
+    template <typename Float>
+    static void
+    convert(Float const* const values, size_t const count, exact_batch_result& result, exact_format const& format)
+    {
+        mp::cpp_int value;
+
+        result.offsets.clear();
+        result.offsets.reserve(count + 1);
+        result.offsets.push_back(0);
+        // Start from whatever the result already holds; most values are short.
+        if (result.text.size() < 32 * count)
+            result.text.resize(32 * count);
+        size_t used = 0;
+        for (size_t i = 0; i < count; ++i) {
+            FloatInfo const info(values[i]);
+            for (;;) {
+                char* const first = &result.text[0];
+                auto const written = info.write(first + used, first + result.text.size(), format, value);
+                if (written.ec == std::errc()) {
+                    count_conversion(info, written.ptr - (first + used));
+                    used = written.ptr - first;
+                    break;
+                }
+                result.text.resize(std::max(2 * result.text.size(), used + info.length(format, value)));
+            }
+            result.offsets.push_back(used);
+        }
+        result.text.resize(used);
     }
+};
+
+#ifdef BOOST_FLOAT80_C
+void
+exact_batch(boost::float80_t const* values, size_t count, exact_batch_result& result, exact_format const& format)
+{
+    batch_converter::convert(values, count, result, format);
+}
+#endif
+
+#ifdef BOOST_FLOAT64_C
+void
+exact_batch(boost::float64_t const* values, size_t count, exact_batch_result& result, exact_format const& format)
+{
+    batch_converter::convert(values, count, result, format);
+}
+#endif
+
+#ifdef BOOST_FLOAT32_C
+void
+exact_batch(boost::float32_t const* values, size_t count, exact_batch_result& result, exact_format const& format)
+{
+    batch_converter::convert(values, count, result, format);
+}
+#endif
+
+exact_digits::exact_digits(FloatInfo const& info):
+    m_stage(stage::sign),
+    m_negative(info.negative),
+    m_whole_digits(0),
+    m_fraction_bits(0),
+    m_fraction_digits(0)
+{
+    switch (info.number_type) {
+        case normal:
+        case zero:
+        case denormal: {
+            int bin_exp;
+            info.decompose(m_value, bin_exp);
+            if (!m_value.is_zero()) {
+                unsigned const zeros = mp::lsb(m_value);
+                m_value >>= zeros;
+                bin_exp += zeros;
+            }
+            if (bin_exp >= 0) {
+                m_value <<= bin_exp;
+            } else {
+                m_fraction_bits = m_fraction_digits = -bin_exp;
+            }
+            mp::cpp_int const whole = m_value >> m_fraction_bits;
+            m_whole_digits = decimal_digits(whole);
+            unsigned const below = (m_whole_digits - 1) / chunk_digits * chunk_digits;
+            m_scale = mp::cpp_int(power_of_five<mp::cpp_int>(below)) << below;
+            break;
+        }
+        default: {
+            // Special values are short enough to produce all at once.
+            auto const result = exact_to_chars(std::begin(m_chunk), std::end(m_chunk), info);
+            m_whole_digits = result.ptr - m_chunk;
+            m_stage = stage::done;
+            m_negative = false;
+            break;
+        }
+    }
+}
+
+bool
+exact_digits::next(char const*& first, char const*& last)
+{
+    first = m_chunk;
+    switch (m_stage) {
+        case stage::sign:
+            m_stage = stage::whole;
+            if (m_negative) {
+                m_chunk[0] = '-';
+                last = first + 1;
+                return true;
+            }
+            // fall through
+        case stage::whole: {
+            // The leading chunk takes whatever doesn't divide evenly.
+            size_t const width = m_whole_digits - (m_whole_digits - 1) / chunk_digits * chunk_digits;
+            mp::cpp_int const digits = (m_value >> m_fraction_bits) / m_scale;
+            m_value -= (digits * m_scale) << m_fraction_bits;
+            last = write_chunk(digits.convert_to<std::uint64_t>(), width, m_chunk);
+            m_whole_digits -= width;
+            if (m_whole_digits == 0)
+                m_stage = m_fraction_digits > 0 ? stage::point : stage::done;
+            else
+                m_scale /= decimal_chunk;
+            return true;
+        }
+        case stage::point:
+            m_chunk[0] = '.';
+            last = first + 1;
+            m_stage = stage::fraction;
+            return true;
+        case stage::fraction: {
+            size_t const width = std::min<size_t>(m_fraction_digits, chunk_digits);
+            std::uint64_t scale = 1;
+            for (size_t i = 0; i < width; ++i)
+                scale *= 10;
+            m_value *= scale;
+            mp::cpp_int const digits = m_value >> m_fraction_bits;
+            m_value -= digits << m_fraction_bits;
+            last = write_chunk(digits.convert_to<std::uint64_t>(), width, m_chunk);
+            m_fraction_digits -= width;
+            if (m_fraction_digits == 0)
+                m_stage = stage::done;
+            return true;
+        }
+        case stage::done:
+        default:
+            // Special values were written in the constructor.
+            last = first + m_whole_digits;
+            m_whole_digits = 0;
+            return first != last;
+    }
+}
+
+exact_digits::iterator
+exact_digits::begin()
+{
+    char const* first;
+    char const* last;
+    if (!next(first, last))
+        return end();
+    return iterator(this, first, last);
+}
+
+exact_digits::iterator
+exact_digits::end()
+{
+    return iterator();
+}
+
+std::ostream&
+operator<<(std::ostream& os, FloatInfo const& info)
+{
+    stage_clock clock;
+    exact_format const format(os);
+    clock.lap(exact_stage::format);
+    bool const numeric = info.number_type == normal
+        || info.number_type == zero
+        || info.number_type == denormal;
+
+    // Most values fit on the stack; size a buffer for the rest.
+    char local[512];
+    std::vector<char> buffer;
+    char* first = local;
+    size_t const length = exact_length(info, format);
+    if (length > sizeof local) {
+        buffer.resize(length);
+        first = buffer.data();
+    }
+    clock.lap(exact_stage::length);
+    auto const result = exact_to_chars(first, first + length, info, format);
+    clock.restart();
+    write_padded(os, first, result.ptr, numeric);
+    clock.lap(exact_stage::output);
+    return os;
+}
+
+void
+enable_exact_stats(bool const enable)
+{
+    counters.enabled.store(enable, std::memory_order_relaxed);
+}
+
+exact_stats
+get_exact_stats()
+{
+    exact_stats stats;
+    for (unsigned kind = 0; kind < float_kinds; ++kind)
+        for (unsigned type = 0; type <= signaling_nan; ++type)
+            stats.conversions[kind][type] = counters.conversions[kind][type].load(std::memory_order_relaxed);
+    for (unsigned stage = 0; stage < exact_stages; ++stage)
+        stats.stage_ns[stage] = counters.stage_ns[stage].load(std::memory_order_relaxed);
+    stats.peak_limbs = counters.peak_limbs.load(std::memory_order_relaxed);
+    stats.output_bytes = counters.output_bytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void
+reset_exact_stats()
+{
+    for (auto& kind: counters.conversions)
+        for (auto& count: kind)
+            count.store(0, std::memory_order_relaxed);
+    for (auto& ns: counters.stage_ns)
+        ns.store(0, std::memory_order_relaxed);
+    counters.peak_limbs.store(0, std::memory_order_relaxed);
+    counters.output_bytes.store(0, std::memory_order_relaxed);
 }
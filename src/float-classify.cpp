@@ -0,0 +1,387 @@
+#include "config.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include "float-classify.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CLASSIFY_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Where a kernel writes, one pointer per column
+struct column_pointers
+{
+    unsigned char* negative;
+    std::uint32_t* exponent;
+    std::uint64_t* mantissa;
+    float_type* type;
+    size_t* histogram;
+};
+
+template <typename Float>
+void
+classify_scalar(Float const* const values, size_t const first, size_t const last, column_pointers const& out)
+{
+    using traits = float_traits<Float>;
+    for (size_t i = first; i < last; ++i) {
+        typename detail::float_word<traits::bits>::type word;
+        std::memcpy(&word, values + i, sizeof word);
+        out.negative[i] = word >> (traits::bits - 1);
+        out.exponent[i] = (word >> traits::mantissa_bits) & traits::exponent_mask;
+        out.mantissa[i] = word & traits::mantissa_mask;
+        out.type[i] = get_float_type(out.exponent[i], out.mantissa[i], traits::kind);
+        ++out.histogram[out.type[i]];
+    }
+}
+
+#ifdef CLASSIFY_X86
+
+// The kernels below compute every lane's class without branches:
+//
+//     exponent all zeros: zero if the mantissa is zero, else denormal
+//     exponent all ones:  infinity if the mantissa is zero, else a NaN that
+//                         is quiet when the mantissa's top bit is set
+//     otherwise:          normal
+//
+// which is what get_float_type reports for types with an implied integer
+// bit. Each class but normal has a vector of per-lane counts, which is added
+// into the histogram after every chunk, before any lane can overflow.
+size_t const chunk_values = size_t(1) << 28;
+float_type const counted_types[] { zero, denormal, infinity, quiet_nan, signaling_nan };
+size_t const counted = sizeof counted_types / sizeof counted_types[0];
+
+// Add the lanes of each counter, which are Lane wide, into the histogram.
+template <typename Lane, typename Vector>
+void
+flush_counts(Vector (&counts)[counted], size_t const values, size_t* const histogram)
+{
+    size_t total = 0;
+    for (size_t c = 0; c < counted; ++c) {
+        Lane lanes[sizeof(Vector) / sizeof(Lane)];
+        std::memcpy(lanes, &counts[c], sizeof lanes);
+        for (Lane const lane: lanes) {
+            histogram[counted_types[c]] += lane;
+            total += lane;
+        }
+        std::memset(&counts[c], 0, sizeof counts[c]);
+    }
+    histogram[normal] += values - total;
+}
+
+__attribute__((target("sse2"), always_inline)) inline
+__m128i
+select128(__m128i const mask, __m128i const if_set, __m128i const if_clear)
+{
+    return _mm_or_si128(_mm_and_si128(mask, if_set), _mm_andnot_si128(mask, if_clear));
+}
+
+// Equality of 64-bit lanes, which SSE2 only has for 32-bit ones
+__attribute__((target("sse2"), always_inline)) inline
+__m128i
+equal64(__m128i const a, __m128i const b)
+{
+    __m128i const halves = _mm_cmpeq_epi32(a, b);
+    return _mm_and_si128(halves, _mm_shuffle_epi32(halves, _MM_SHUFFLE(2, 3, 0, 1)));
+}
+
+__attribute__((target("avx2"), always_inline)) inline
+__m256i
+select256(__m256i const mask, __m256i const if_set, __m256i const if_clear)
+{
+    return _mm256_or_si256(_mm256_and_si256(mask, if_set), _mm256_andnot_si256(mask, if_clear));
+}
+
+__attribute__((target("sse2")))
+size_t
+classify_sse2(boost::float32_t const* const values, size_t const count, column_pointers const& out)
+{
+    size_t const blocks = count / 4 * 4;
+    __m128i const none = _mm_setzero_si128();
+    __m128i const exponent_mask = _mm_set1_epi32(0xff);
+    __m128i const mantissa_mask = _mm_set1_epi32(0x7fffff);
+    __m128i const quiet_bit = _mm_set1_epi32(0x400000);
+    __m128i counts[counted] {};
+    for (size_t start = 0; start < blocks; start += chunk_values) {
+        size_t const stop = std::min(blocks, start + chunk_values);
+        for (size_t i = start; i < stop; i += 4) {
+            __m128i const word = _mm_loadu_si128(reinterpret_cast<__m128i const*>(values + i));
+            __m128i const sign = _mm_srli_epi32(word, 31);
+            __m128i const exponent = _mm_and_si128(_mm_srli_epi32(word, 23), exponent_mask);
+            __m128i const mantissa = _mm_and_si128(word, mantissa_mask);
+            __m128i const empty = _mm_cmpeq_epi32(mantissa, none);
+            __m128i const quiet = _mm_cmpeq_epi32(_mm_and_si128(mantissa, quiet_bit), quiet_bit);
+            __m128i const low = _mm_cmpeq_epi32(exponent, none);
+            __m128i const high = _mm_cmpeq_epi32(exponent, exponent_mask);
+            __m128i const nan = _mm_andnot_si128(empty, high);
+            __m128i const masks[counted] {
+                _mm_and_si128(low, empty), _mm_andnot_si128(empty, low), _mm_and_si128(high, empty),
+                _mm_and_si128(nan, quiet), _mm_andnot_si128(quiet, nan),
+            };
+            __m128i type = _mm_set1_epi32(normal);
+            type = select128(masks[0], _mm_set1_epi32(counted_types[0]), type);
+            type = select128(masks[1], _mm_set1_epi32(counted_types[1]), type);
+            type = select128(masks[2], _mm_set1_epi32(counted_types[2]), type);
+            type = select128(masks[3], _mm_set1_epi32(counted_types[3]), type);
+            type = select128(masks[4], _mm_set1_epi32(counted_types[4]), type);
+            counts[0] = _mm_sub_epi32(counts[0], masks[0]);
+            counts[1] = _mm_sub_epi32(counts[1], masks[1]);
+            counts[2] = _mm_sub_epi32(counts[2], masks[2]);
+            counts[3] = _mm_sub_epi32(counts[3], masks[3]);
+            counts[4] = _mm_sub_epi32(counts[4], masks[4]);
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out.exponent + i), exponent);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out.mantissa + i), _mm_unpacklo_epi32(mantissa, none));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out.mantissa + i + 2), _mm_unpackhi_epi32(mantissa, none));
+            // Bytes 0-3 hold the signs and 4-7 the types.
+            __m128i const bytes = _mm_packus_epi16(_mm_packs_epi32(sign, type), none);
+            std::uint32_t const signs = _mm_cvtsi128_si32(bytes);
+            std::uint32_t const types = _mm_cvtsi128_si32(_mm_srli_si128(bytes, 4));
+            std::memcpy(out.negative + i, &signs, 4);
+            std::memcpy(out.type + i, &types, 4);
+        }
+        flush_counts<std::uint32_t>(counts, stop - start, out.histogram);
+    }
+    return blocks;
+}
+
+__attribute__((target("sse2")))
+size_t
+classify_sse2(boost::float64_t const* const values, size_t const count, column_pointers const& out)
+{
+    size_t const blocks = count / 2 * 2;
+    __m128i const none = _mm_setzero_si128();
+    __m128i const exponent_mask = _mm_set1_epi64x(0x7ff);
+    __m128i const mantissa_mask = _mm_set1_epi64x(0xfffffffffffffLL);
+    __m128i const quiet_bit = _mm_set1_epi64x(0x8000000000000LL);
+    __m128i counts[counted] {};
+    for (size_t start = 0; start < blocks; start += chunk_values) {
+        size_t const stop = std::min(blocks, start + chunk_values);
+        for (size_t i = start; i < stop; i += 2) {
+            __m128i const word = _mm_loadu_si128(reinterpret_cast<__m128i const*>(values + i));
+            __m128i const sign = _mm_srli_epi64(word, 63);
+            __m128i const exponent = _mm_and_si128(_mm_srli_epi64(word, 52), exponent_mask);
+            __m128i const mantissa = _mm_and_si128(word, mantissa_mask);
+            __m128i const empty = equal64(mantissa, none);
+            __m128i const quiet = equal64(_mm_and_si128(mantissa, quiet_bit), quiet_bit);
+            __m128i const low = equal64(exponent, none);
+            __m128i const high = equal64(exponent, exponent_mask);
+            __m128i const nan = _mm_andnot_si128(empty, high);
+            __m128i const masks[counted] {
+                _mm_and_si128(low, empty), _mm_andnot_si128(empty, low), _mm_and_si128(high, empty),
+                _mm_and_si128(nan, quiet), _mm_andnot_si128(quiet, nan),
+            };
+            __m128i type = _mm_set1_epi64x(normal);
+            type = select128(masks[0], _mm_set1_epi64x(counted_types[0]), type);
+            type = select128(masks[1], _mm_set1_epi64x(counted_types[1]), type);
+            type = select128(masks[2], _mm_set1_epi64x(counted_types[2]), type);
+            type = select128(masks[3], _mm_set1_epi64x(counted_types[3]), type);
+            type = select128(masks[4], _mm_set1_epi64x(counted_types[4]), type);
+            counts[0] = _mm_sub_epi64(counts[0], masks[0]);
+            counts[1] = _mm_sub_epi64(counts[1], masks[1]);
+            counts[2] = _mm_sub_epi64(counts[2], masks[2]);
+            counts[3] = _mm_sub_epi64(counts[3], masks[3]);
+            counts[4] = _mm_sub_epi64(counts[4], masks[4]);
+
+            // Gather the low halves of the 64-bit lanes into the bottom 64 bits.
+            __m128i const exponents = _mm_shuffle_epi32(exponent, _MM_SHUFFLE(3, 1, 2, 0));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out.exponent + i), exponents);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out.mantissa + i), mantissa);
+            // Bytes 0-1 hold the signs and 2-3 the types.
+            __m128i const narrow = _mm_unpacklo_epi64(_mm_shuffle_epi32(sign, _MM_SHUFFLE(3, 1, 2, 0)),
+                                                      _mm_shuffle_epi32(type, _MM_SHUFFLE(3, 1, 2, 0)));
+            std::uint32_t const bytes = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(narrow, none), none));
+            out.negative[i] = bytes & 0xff;
+            out.negative[i + 1] = bytes >> 8 & 0xff;
+            out.type[i] = float_type(bytes >> 16 & 0xff);
+            out.type[i + 1] = float_type(bytes >> 24);
+        }
+        flush_counts<std::uint64_t>(counts, stop - start, out.histogram);
+    }
+    return blocks;
+}
+
+__attribute__((target("avx2")))
+size_t
+classify_avx2(boost::float32_t const* const values, size_t const count, column_pointers const& out)
+{
+    size_t const blocks = count / 8 * 8;
+    __m256i const none = _mm256_setzero_si256();
+    __m256i const exponent_mask = _mm256_set1_epi32(0xff);
+    __m256i const mantissa_mask = _mm256_set1_epi32(0x7fffff);
+    __m256i const quiet_bit = _mm256_set1_epi32(0x400000);
+    __m256i counts[counted] {};
+    for (size_t start = 0; start < blocks; start += chunk_values) {
+        size_t const stop = std::min(blocks, start + chunk_values);
+        for (size_t i = start; i < stop; i += 8) {
+            __m256i const word = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(values + i));
+            __m256i const sign = _mm256_srli_epi32(word, 31);
+            __m256i const exponent = _mm256_and_si256(_mm256_srli_epi32(word, 23), exponent_mask);
+            __m256i const mantissa = _mm256_and_si256(word, mantissa_mask);
+            __m256i const empty = _mm256_cmpeq_epi32(mantissa, none);
+            __m256i const quiet = _mm256_cmpeq_epi32(_mm256_and_si256(mantissa, quiet_bit), quiet_bit);
+            __m256i const low = _mm256_cmpeq_epi32(exponent, none);
+            __m256i const high = _mm256_cmpeq_epi32(exponent, exponent_mask);
+            __m256i const nan = _mm256_andnot_si256(empty, high);
+            __m256i const masks[counted] {
+                _mm256_and_si256(low, empty), _mm256_andnot_si256(empty, low), _mm256_and_si256(high, empty),
+                _mm256_and_si256(nan, quiet), _mm256_andnot_si256(quiet, nan),
+            };
+            __m256i type = _mm256_set1_epi32(normal);
+            type = select256(masks[0], _mm256_set1_epi32(counted_types[0]), type);
+            type = select256(masks[1], _mm256_set1_epi32(counted_types[1]), type);
+            type = select256(masks[2], _mm256_set1_epi32(counted_types[2]), type);
+            type = select256(masks[3], _mm256_set1_epi32(counted_types[3]), type);
+            type = select256(masks[4], _mm256_set1_epi32(counted_types[4]), type);
+            counts[0] = _mm256_sub_epi32(counts[0], masks[0]);
+            counts[1] = _mm256_sub_epi32(counts[1], masks[1]);
+            counts[2] = _mm256_sub_epi32(counts[2], masks[2]);
+            counts[3] = _mm256_sub_epi32(counts[3], masks[3]);
+            counts[4] = _mm256_sub_epi32(counts[4], masks[4]);
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out.exponent + i), exponent);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out.mantissa + i),
+                                _mm256_cvtepu32_epi64(_mm256_castsi256_si128(mantissa)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out.mantissa + i + 4),
+                                _mm256_cvtepu32_epi64(_mm256_extracti128_si256(mantissa, 1)));
+            // Packing works within 128-bit halves, so pack the halves together.
+            // Bytes 0-7 hold the signs and 8-15 the types.
+            __m128i const signs = _mm_packs_epi32(_mm256_castsi256_si128(sign), _mm256_extracti128_si256(sign, 1));
+            __m128i const types = _mm_packs_epi32(_mm256_castsi256_si128(type), _mm256_extracti128_si256(type, 1));
+            __m128i const bytes = _mm_packus_epi16(signs, types);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out.negative + i), bytes);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out.type + i), _mm_srli_si128(bytes, 8));
+        }
+        flush_counts<std::uint32_t>(counts, stop - start, out.histogram);
+    }
+    return blocks;
+}
+
+__attribute__((target("avx2")))
+size_t
+classify_avx2(boost::float64_t const* const values, size_t const count, column_pointers const& out)
+{
+    size_t const blocks = count / 4 * 4;
+    __m256i const none = _mm256_setzero_si256();
+    __m256i const exponent_mask = _mm256_set1_epi64x(0x7ff);
+    __m256i const mantissa_mask = _mm256_set1_epi64x(0xfffffffffffffLL);
+    __m256i const quiet_bit = _mm256_set1_epi64x(0x8000000000000LL);
+    __m256i const low_halves = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    __m256i counts[counted] {};
+    for (size_t start = 0; start < blocks; start += chunk_values) {
+        size_t const stop = std::min(blocks, start + chunk_values);
+        for (size_t i = start; i < stop; i += 4) {
+            __m256i const word = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(values + i));
+            __m256i const sign = _mm256_srli_epi64(word, 63);
+            __m256i const exponent = _mm256_and_si256(_mm256_srli_epi64(word, 52), exponent_mask);
+            __m256i const mantissa = _mm256_and_si256(word, mantissa_mask);
+            __m256i const empty = _mm256_cmpeq_epi64(mantissa, none);
+            __m256i const quiet = _mm256_cmpeq_epi64(_mm256_and_si256(mantissa, quiet_bit), quiet_bit);
+            __m256i const low = _mm256_cmpeq_epi64(exponent, none);
+            __m256i const high = _mm256_cmpeq_epi64(exponent, exponent_mask);
+            __m256i const nan = _mm256_andnot_si256(empty, high);
+            __m256i const masks[counted] {
+                _mm256_and_si256(low, empty), _mm256_andnot_si256(empty, low), _mm256_and_si256(high, empty),
+                _mm256_and_si256(nan, quiet), _mm256_andnot_si256(quiet, nan),
+            };
+            __m256i type = _mm256_set1_epi64x(normal);
+            type = select256(masks[0], _mm256_set1_epi64x(counted_types[0]), type);
+            type = select256(masks[1], _mm256_set1_epi64x(counted_types[1]), type);
+            type = select256(masks[2], _mm256_set1_epi64x(counted_types[2]), type);
+            type = select256(masks[3], _mm256_set1_epi64x(counted_types[3]), type);
+            type = select256(masks[4], _mm256_set1_epi64x(counted_types[4]), type);
+            counts[0] = _mm256_sub_epi64(counts[0], masks[0]);
+            counts[1] = _mm256_sub_epi64(counts[1], masks[1]);
+            counts[2] = _mm256_sub_epi64(counts[2], masks[2]);
+            counts[3] = _mm256_sub_epi64(counts[3], masks[3]);
+            counts[4] = _mm256_sub_epi64(counts[4], masks[4]);
+
+            // Gather the low halves of the 64-bit lanes into the bottom 128 bits.
+            __m128i const exponents = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(exponent, low_halves));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out.exponent + i), exponents);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out.mantissa + i), mantissa);
+            // Bytes 0-3 hold the signs and 4-7 the types.
+            __m128i const signs = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(sign, low_halves));
+            __m128i const types = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(type, low_halves));
+            __m128i const bytes = _mm_packus_epi16(_mm_packs_epi32(signs, types), _mm_setzero_si128());
+            std::uint32_t const sign_bytes = _mm_cvtsi128_si32(bytes);
+            std::uint32_t const type_bytes = _mm_cvtsi128_si32(_mm_srli_si128(bytes, 4));
+            std::memcpy(out.negative + i, &sign_bytes, 4);
+            std::memcpy(out.type + i, &type_bytes, 4);
+        }
+        flush_counts<std::uint64_t>(counts, stop - start, out.histogram);
+    }
+    return blocks;
+}
+
+#endif
+
+template <typename Float>
+void
+classify(Float const* const values, size_t const count, float_columns& columns, simd_level const level)
+{
+    columns.negative.resize(count);
+    columns.exponent.resize(count);
+    columns.mantissa.resize(count);
+    columns.type.resize(count);
+    columns.histogram.fill(0);
+    column_pointers const out {
+        columns.negative.data(), columns.exponent.data(), columns.mantissa.data(), columns.type.data(),
+        columns.histogram.data()
+    };
+
+    size_t done = 0;
+#ifdef CLASSIFY_X86
+    switch (std::min(level, supported_simd_level())) {
+        case simd_level::avx2:
+            done = classify_avx2(values, count, out);
+            break;
+        case simd_level::sse2:
+            done = classify_sse2(values, count, out);
+            break;
+        case simd_level::scalar:
+            break;
+    }
+#else
+    (void)level;
+#endif
+    classify_scalar(values, done, count, out);
+}
+
+} // namespace
+
+simd_level
+supported_simd_level()
+{
+#ifdef CLASSIFY_X86
+    static simd_level const level = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return simd_level::avx2;
+        if (__builtin_cpu_supports("sse2"))
+            return simd_level::sse2;
+        return simd_level::scalar;
+    }();
+    return level;
+#else
+    return simd_level::scalar;
+#endif
+}
+
+#ifdef BOOST_FLOAT64_C
+void
+classify_floats(boost::float64_t const* values, size_t count, float_columns& columns, simd_level level)
+{
+    classify(values, count, columns, level);
+}
+#endif
+
+#ifdef BOOST_FLOAT32_C
+void
+classify_floats(boost::float32_t const* values, size_t count, float_columns& columns, simd_level level)
+{
+    classify(values, count, columns, level);
+}
+#endif
@@ -1,23 +1,42 @@
 #include "config.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
 #include <cstddef>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <iterator>
+#include <memory>
 #include <string>
+#include <system_error>
+#include <thread>
 #include <vector>
-#include <boost/lexical_cast.hpp>
 #include <boost/format.hpp>
 #include <boost/program_options.hpp>
 #include <boost/mpl/vector.hpp>
 #include <boost/mpl/for_each.hpp>
+#include "decimal-parse.h"
+#include "exact-cache.h"
 #include "exact-float.h"
+#include "float-classify.h"
+#include "mapped-file.h"
+#include "pipeline.h"
 
 struct print_number
 {
 private:
+    std::ostream& m_os;
     std::string const& m_arg;
-    bool& m_error;
+    decimal_value const* m_value;
+    exact_cache* m_cache;
+    std::atomic<bool>& m_error;
 public:
-    print_number(std::string const& arg, bool& error):
-        m_arg(arg), m_error(error)
+    // value is null when arg didn't parse at all, and cache when there's no
+    // --cache.
+    print_number(std::ostream& os, std::string const& arg, decimal_value const* value, exact_cache* cache,
+                 std::atomic<bool>& error):
+        m_os(os), m_arg(arg), m_value(value), m_cache(cache), m_error(error)
     { }
 
     void operator()(int) { }
@@ -25,17 +44,230 @@ public:
     template <typename T>
     void operator()(T)
     {
-        try {
-            T const ld = boost::lexical_cast<T>(m_arg);
-            std::cout << m_arg << " = " << std::showpos << exact(ld) << std::endl;
-        } catch (boost::bad_lexical_cast const& e) {
-            float_traits const& traits = float_trait_map.at(typeid(T));
-            std::cout << boost::format("%s doesn't look like %s %s.") % m_arg % traits.article % traits.name << std::endl;
-            m_error |= true;
+        T ld;
+        if (m_value && m_value->to(ld) == std::errc()) {
+            m_os << m_arg << " = ";
+            if (m_cache)
+                m_cache->write(m_os, exact(ld));
+            else
+                m_os << std::showpos << exact(ld);
+            m_os << '\n';
+        } else {
+            float_descriptor const& traits = describe<T>();
+            m_os << boost::format("%s doesn't look like %s %s.") % m_arg % traits.article % traits.name << '\n';
+            m_error = true;
         }
     }
 };
 
+// Print arg in each float type
+void
+print_all(std::ostream& os, std::string const& arg, exact_cache* cache, std::atomic<bool>& error)
+{
+    decimal_value value;
+    bool const parsed = value.parse(arg.data(), arg.data() + arg.size()) == std::errc();
+    boost::mpl::for_each<boost::mpl::vector<
+#ifdef BOOST_FLOAT80_C
+        boost::float80_t,
+#endif
+#ifdef BOOST_FLOAT64_C
+        boost::float64_t,
+#endif
+#ifdef BOOST_FLOAT32_C
+        boost::float32_t,
+#endif
+        int
+    >::type>(print_number(os, arg, parsed ? &value : nullptr, cache, error));
+}
+
+// Print each value of a binary dump on its own line, converting a chunk of
+// records at a time straight from the file's memory. cache is null when
+// there's no --cache.
+template <typename Float>
+void
+print_binary(mapped_file const& file, record_layout const& layout, exact_cache* const cache, unsigned const threads)
+{
+    size_t const count = layout.count(file.size());
+    size_t const chunk = 4096;
+    size_t next = 0;
+    exact_format format;
+    format.showpos = true;
+    ordered_pipeline<size_t>(threads, 1,
+        [&](size_t& first) {
+            if (next >= count)
+                return false;
+            first = next;
+            next += chunk;
+            return true;
+        },
+        [&](size_t const first, std::ostream& os) {
+            size_t const last = std::min(count, first + chunk);
+            std::vector<Float> values(last - first);
+            read_records(file.data(), layout, first, last, values.data());
+            if (cache) {
+                for (Float const value: values) {
+                    cache->write(os, exact(value));
+                    os << '\n';
+                }
+                return;
+            }
+            exact_batch_result const result = exact_batch(values.data(), values.size(), format);
+            for (size_t i = 0; i < result.size(); ++i) {
+                os.write(result.text.data() + result.offsets[i], result.offsets[i + 1] - result.offsets[i]);
+                os << '\n';
+            }
+        },
+        [](std::string const& text) {
+            std::cout.write(text.data(), text.size());
+        });
+}
+
+// Add how many values of a binary dump have each float_type to histogram,
+// for --classify. Records are copied out a chunk at a time, so any layout
+// works.
+template <typename Float>
+void
+classify_binary(mapped_file const& file, record_layout const& layout, float_columns::histogram_type& histogram)
+{
+    size_t const count = layout.count(file.size());
+    size_t const chunk = 1 << 16;
+    std::vector<Float> values;
+    float_columns columns;
+    for (size_t first = 0; first < count; first += chunk) {
+        size_t const last = std::min(count, first + chunk);
+        values.resize(last - first);
+        read_records(file.data(), layout, first, last, values.data());
+        classify_floats(values.data(), values.size(), columns);
+        for (size_t type = 0; type < histogram.size(); ++type)
+            histogram[type] += columns.histogram[type];
+    }
+}
+
+// The element types --binary accepts
+struct binary_type
+{
+    char const* name;
+    size_t width;
+    void (*print)(mapped_file const&, record_layout const&, exact_cache*, unsigned);
+    // Null when classify_floats doesn't handle the type
+    void (*classify)(mapped_file const&, record_layout const&, float_columns::histogram_type&);
+};
+
+binary_type const binary_types[] = {
+#ifdef BOOST_FLOAT32_C
+    { "f32", float_traits<boost::float32_t>::bits / 8, print_binary<boost::float32_t>,
+      classify_binary<boost::float32_t> },
+#endif
+#ifdef BOOST_FLOAT64_C
+    { "f64", float_traits<boost::float64_t>::bits / 8, print_binary<boost::float64_t>,
+      classify_binary<boost::float64_t> },
+#endif
+#ifdef BOOST_FLOAT80_C
+    { "f80", float_traits<boost::float80_t>::bits / 8, print_binary<boost::float80_t>, nullptr },
+#endif
+};
+
+// With --stats, how --cache fared
+void
+print_cache_stats(exact_cache const& cache)
+{
+    exact_cache_stats const stats = cache.stats();
+    std::cerr << boost::format("%-22s %12d\n") % "cache hits" % stats.hits
+              << boost::format("%-22s %12d\n") % "cache misses" % stats.misses
+              << boost::format("%-22s %12d\n") % "cache entries" % stats.entries;
+}
+
+// Reads newline-separated values a large block at a time. Surrounding
+// blanks, carriage returns, and empty lines are skipped.
+class line_reader
+{
+public:
+    explicit line_reader(std::FILE* file):
+        m_file(file), m_buffer(1 << 20), m_begin(0), m_end(0)
+    { }
+
+    bool next(std::string& line) {
+        do {
+            line.clear();
+            if (!read_line(line))
+                return false;
+            trim(line);
+        } while (line.empty());
+        return true;
+    }
+
+    bool failed() const {
+        return std::ferror(m_file);
+    }
+private:
+    // Append the next line, without its newline. Returns false at the end
+    // of the input.
+    bool read_line(std::string& line) {
+        for (;;) {
+            if (m_begin == m_end && !fill())
+                return !line.empty();
+            char const* const first = m_buffer.data() + m_begin;
+            char const* const last = m_buffer.data() + m_end;
+            char const* const newline = static_cast<char const*>(std::memchr(first, '\n', last - first));
+            line.append(first, newline ? newline : last);
+            if (newline) {
+                m_begin += newline - first + 1;
+                return true;
+            }
+            m_begin = m_end;
+        }
+    }
+
+    bool fill() {
+        m_begin = 0;
+        m_end = std::fread(m_buffer.data(), 1, m_buffer.size(), m_file);
+        return m_end > 0;
+    }
+
+    static void trim(std::string& line) {
+        char const* const blanks = " \t\r";
+        line.erase(line.find_last_not_of(blanks) + 1);
+        line.erase(0, line.find_first_not_of(blanks));
+    }
+
+    std::FILE* const m_file;
+    std::vector<char> m_buffer;
+    size_t m_begin;
+    size_t m_end;
+};
+
+// Prints exact_stats to standard error when main returns, if --stats asked
+// for them.
+class stats_report
+{
+public:
+    explicit stats_report(bool const enabled):
+        m_enabled(enabled)
+    {
+        enable_exact_stats(enabled);
+    }
+
+    ~stats_report() {
+        if (!m_enabled)
+            return;
+        exact_stats const stats = get_exact_stats();
+        for (unsigned kind = 0; kind < float_kinds; ++kind)
+            for (unsigned type = 0; type <= signaling_nan; ++type)
+                if (stats.conversions[kind][type] != 0)
+                    std::cerr << boost::format("%-8s %-13s %12d conversions\n")
+                                 % describe(static_cast<float_kind>(kind)).name % static_cast<float_type>(type)
+                                 % stats.conversions[kind][type];
+        for (unsigned stage = 0; stage < exact_stages; ++stage)
+            std::cerr << boost::format("%-22s %12.3f ms\n")
+                         % static_cast<exact_stage>(stage) % (stats.stage_ns[stage] / 1e6);
+        std::cerr << boost::format("%-22s %12d\n") % "peak limbs" % stats.peak_limbs
+                  << boost::format("%-22s %12d\n") % "output bytes" % stats.output_bytes
+                  << std::flush;
+    }
+private:
+    bool const m_enabled;
+};
+
 int
 main(int argc, char const* argv[])
 {
@@ -44,6 +276,16 @@ main(int argc, char const* argv[])
     desc.add_options()
         ("help", "display program help")
         ("version", "display program version")
+        ("threads", po::value<unsigned>()->default_value(1),
+         "convert on this many threads, keeping output in input order; 0 uses every core")
+        ("input", po::value<std::string>(), "also read newline-separated values from this file, or - for standard input")
+        ("binary", po::value<std::string>(),
+         "treat the arguments as files of raw f32, f64, or f80 values in native byte order")
+        ("offset", po::value<size_t>()->default_value(0), "with --binary, bytes to skip before the first value")
+        ("stride", po::value<size_t>(), "with --binary, bytes from one value to the next; defaults to the value size")
+        ("classify", "with --binary f32 or f64, count the values of each float type instead of converting them")
+        ("stats", "print conversion counts and time per stage to standard error at exit")
+        ("cache", po::value<size_t>(), "reuse the text of up to this many recently seen values")
         ("number", po::value<std::vector<std::string>>()->composing(), "floating-point value to display")
         ;
     po::positional_options_description pd;
@@ -51,6 +293,8 @@ main(int argc, char const* argv[])
     po::variables_map vm;
     po::store(po::command_line_parser(argc, argv).options(desc).positional(pd).run(), vm);
     po::notify(vm);
+    // Output goes out a batch at a time; C stdio needn't see it.
+    std::ios_base::sync_with_stdio(false);
 
     if (vm.count("help")) {
         std::cout << desc << std::endl;
@@ -60,24 +304,116 @@ main(int argc, char const* argv[])
         std::cout << PACKAGE_STRING << std::endl;
         return EXIT_SUCCESS;
     }
-    auto const& args(vm["number"].as<std::vector<std::string>>());
+    stats_report const report(vm.count("stats") != 0);
+    std::vector<std::string> const args = vm.count("number")
+        ? vm["number"].as<std::vector<std::string>>()
+        : std::vector<std::string>();
 
-    if (args.empty())
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> input(nullptr, std::fclose);
+    if (vm.count("input")) {
+        std::string const& name = vm["input"].as<std::string>();
+        if (name == "-") {
+            input = decltype(input)(stdin, [](std::FILE*) { return 0; });
+        } else {
+            input.reset(std::fopen(name.c_str(), "rb"));
+            if (!input) {
+                std::cerr << boost::format("Can't open %s: %s") % name % std::strerror(errno) << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    if (args.empty() && !input)
+        return EXIT_FAILURE;
+    unsigned threads = vm["threads"].as<unsigned>();
+    if (threads == 0)
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    std::unique_ptr<exact_cache> cache;
+    if (vm.count("cache")) {
+        exact_format format;
+        format.showpos = true;
+        cache.reset(new exact_cache(vm["cache"].as<size_t>(), format));
+    }
+
+    if (vm.count("classify") && !vm.count("binary")) {
+        std::cerr << "--classify needs --binary" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (vm.count("binary")) {
+        std::string const& type_name = vm["binary"].as<std::string>();
+        binary_type const* const type = std::find_if(std::begin(binary_types), std::end(binary_types),
+            [&](binary_type const& t) { return type_name == t.name; });
+        if (type == std::end(binary_types)) {
+            std::cerr << boost::format("Unknown binary type %s") % type_name << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (input) {
+            std::cerr << "--input can't be used with --binary" << std::endl;
+            return EXIT_FAILURE;
+        }
+        bool const classify = vm.count("classify") != 0;
+        if (classify && !type->classify) {
+            std::cerr << boost::format("--classify can't be used with %s") % type->name << std::endl;
+            return EXIT_FAILURE;
+        }
+        record_layout layout;
+        layout.offset = vm["offset"].as<size_t>();
+        layout.width = type->width;
+        layout.stride = vm.count("stride") ? vm["stride"].as<size_t>() : type->width;
+        if (layout.stride < layout.width) {
+            std::cerr << boost::format("--stride can't be less than %d bytes for %s") % layout.width % type->name
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+        float_columns::histogram_type histogram = {};
+        for (std::string const& name: args) {
+            try {
+                mapped_file const file(name);
+                if (classify)
+                    type->classify(file, layout, histogram);
+                else
+                    type->print(file, layout, cache.get(), threads);
+            } catch (std::system_error const& e) {
+                std::cout.flush();
+                std::cerr << boost::format("Can't open %s: %s") % name % e.code().message() << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        if (classify)
+            for (size_t t = 0; t < histogram.size(); ++t)
+                if (histogram[t] != 0)
+                    std::cout << boost::format("%-14s %12d\n") % static_cast<float_type>(t) % histogram[t];
+        std::cout.flush();
+        if (cache && vm.count("stats"))
+            print_cache_stats(*cache);
+        return EXIT_SUCCESS;
+    }
+
+    std::atomic<bool> error(false);
+    // Arguments first, then the input file
+    auto next_arg = args.begin();
+    std::unique_ptr<line_reader> lines(input ? new line_reader(input.get()) : nullptr);
+    ordered_pipeline<std::string>(threads, 256,
+        [&](std::string& arg) {
+            if (next_arg != args.end()) {
+                arg = *next_arg++;
+                return true;
+            }
+            return lines && lines->next(arg);
+        },
+        [&](std::string const& arg, std::ostream& os) {
+            print_all(os, arg, cache.get(), error);
+        },
+        [](std::string const& text) {
+            std::cout.write(text.data(), text.size());
+        });
+    std::cout.flush();
+    if (cache && vm.count("stats"))
+        print_cache_stats(*cache);
+    if (lines && lines->failed()) {
+        std::cerr << "Error reading input" << std::endl;
         return EXIT_FAILURE;
-    bool error = false;
-    for (auto arg: args) {
-        boost::mpl::for_each<boost::mpl::vector<
-#ifdef BOOST_FLOAT80_C
-            boost::float80_t,
-#endif
-#ifdef BOOST_FLOAT64_C
-            boost::float64_t,
-#endif
-#ifdef BOOST_FLOAT32_C
-            boost::float32_t,
-#endif
-            int
-        >::type>(print_number(arg, error));
     }
     return error ? EXIT_FAILURE : EXIT_SUCCESS;
 }
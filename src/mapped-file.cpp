@@ -0,0 +1,109 @@
+#include "config.h"
+#include <cerrno>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+#include "mapped-file.h"
+
+#ifdef HAVE_SYS_MMAN_H
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Closes a file descriptor when it goes out of scope
+struct descriptor
+{
+    int const fd;
+    ~descriptor() {
+        if (fd >= 0)
+            ::close(fd);
+    }
+};
+
+std::system_error
+last_error(std::string const& name)
+{
+    return std::system_error(errno, std::generic_category(), name);
+}
+
+// Read everything left in file into contents, for files that can't be
+// mapped or don't know their size, such as pipes
+void
+read_all(int const fd, std::vector<char>& contents, std::string const& name)
+{
+    size_t used = 0;
+    contents.resize(1 << 16);
+    for (;;) {
+        ssize_t const count = ::read(fd, contents.data() + used, contents.size() - used);
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            throw last_error(name);
+        }
+        if (count == 0)
+            break;
+        used += count;
+        if (used == contents.size())
+            contents.resize(2 * used);
+    }
+    contents.resize(used);
+}
+
+}
+
+mapped_file::mapped_file(std::string const& name):
+    m_data(nullptr), m_size(0)
+{
+    descriptor const file { ::open(name.c_str(), O_RDONLY) };
+    if (file.fd < 0)
+        throw last_error(name);
+    struct stat status;
+    if (::fstat(file.fd, &status) != 0)
+        throw last_error(name);
+    if (!S_ISREG(status.st_mode)) {
+        read_all(file.fd, m_copy, name);
+        m_data = m_copy.data();
+        m_size = m_copy.size();
+        return;
+    }
+    m_size = status.st_size;
+    // Mapping zero bytes fails, and there'd be nothing to read anyway.
+    if (m_size == 0)
+        return;
+    void* const address = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file.fd, 0);
+    if (address == MAP_FAILED)
+        throw last_error(name);
+    // Values are read front to back.
+    ::madvise(address, m_size, MADV_SEQUENTIAL);
+    m_data = static_cast<char const*>(address);
+}
+
+mapped_file::~mapped_file()
+{
+    if (m_data && m_data != m_copy.data())
+        ::munmap(const_cast<char*>(m_data), m_size);
+}
+
+#else
+
+mapped_file::mapped_file(std::string const& name):
+    m_data(nullptr), m_size(0)
+{
+    std::ifstream file(name, std::ios::binary);
+    if (!file)
+        throw std::system_error(errno, std::generic_category(), name);
+    m_copy.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    if (file.bad())
+        throw std::system_error(errno, std::generic_category(), name);
+    m_data = m_copy.data();
+    m_size = m_copy.size();
+}
+
+mapped_file::~mapped_file()
+{
+}
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef EXACT_FLOAT_MAPPED_FILE_H
+#define EXACT_FLOAT_MAPPED_FILE_H
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// The whole contents of a file, read-only. Where the system has mmap, a
+// regular file is mapped instead of read, so even a huge dump costs nothing
+// up front and its pages load as they're used. Other files, such as pipes,
+// are read to the end.
+class mapped_file
+{
+public:
+    // Throws std::system_error if the file can't be opened or read.
+    explicit mapped_file(std::string const& name);
+    ~mapped_file();
+
+    mapped_file(mapped_file const&) = delete;
+    mapped_file& operator=(mapped_file const&) = delete;
+
+    char const* data() const {
+        return m_data;
+    }
+
+    size_t size() const {
+        return m_size;
+    }
+private:
+    char const* m_data;
+    size_t m_size;
+    // Holds the contents when the file isn't mapped
+    std::vector<char> m_copy;
+};
+
+// Where the values lie in a file of fixed-size records, such as an array of
+// floats or an array of structs with a float member
+struct record_layout
+{
+    // Bytes before the first value
+    size_t offset;
+    // Bytes from the start of one value to the start of the next
+    size_t stride;
+    // Bytes in each value
+    size_t width;
+
+    // How many whole values fit in size bytes
+    size_t count(size_t const size) const {
+        if (size < offset || size - offset < width)
+            return 0;
+        return (size - offset - width) / stride + 1;
+    }
+};
+
+// Copy values [first, last) out of data into out. Records needn't be aligned.
+// A value narrower than Float, such as a 10-byte extended value read into a
+// 16-byte long double, fills Float's leading bytes and zeros the rest.
+template <typename Float>
+void
+read_records(char const* const data, record_layout const& layout, size_t const first, size_t const last,
+             Float* out)
+{
+    char const* record = data + layout.offset + first * layout.stride;
+    for (size_t i = first; i < last; ++i, ++out, record += layout.stride) {
+        if (layout.width < sizeof(Float))
+            std::memset(out, 0, sizeof(Float));
+        std::memcpy(out, record, layout.width);
+    }
+}
+
+#endif
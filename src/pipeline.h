@@ -0,0 +1,169 @@
+#ifndef EXACT_FLOAT_PIPELINE_H
+#define EXACT_FLOAT_PIPELINE_H
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// A queue that makes producers wait once it holds capacity items, so a fast
+// stage can't run arbitrarily far ahead of a slow one.
+template <typename T>
+class bounded_queue
+{
+public:
+    explicit bounded_queue(size_t const capacity):
+        m_capacity(capacity), m_closed(false)
+    { }
+
+    void push(T item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_full.wait(lock, [this] { return m_items.size() < m_capacity; });
+        m_items.push_back(std::move(item));
+        m_not_empty.notify_one();
+    }
+
+    // Wait for an item. Returns false once the queue is closed and drained.
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_empty.wait(lock, [this] { return !m_items.empty() || m_closed; });
+        if (m_items.empty())
+            return false;
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        m_not_full.notify_one();
+        return true;
+    }
+
+    // No more pushes will come; wake everyone waiting to pop.
+    void close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_not_empty.notify_all();
+    }
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_not_empty;
+    std::condition_variable m_not_full;
+    std::deque<T> m_items;
+    size_t const m_capacity;
+    bool m_closed;
+};
+
+/**
+ * Read inputs with source, format each one with convert on a pool of worker
+ * threads, and pass the text to sink in input order.
+ *
+ * A reader thread groups inputs into numbered batches. Idle workers take the
+ * next batch from a shared queue, so a slow batch never holds up the others,
+ * and the calling thread puts finished batches back in order for sink. The
+ * reader stays at most 2 * threads batches ahead of the oldest one sink
+ * hasn't had yet, which caps how many batches are in flight at once, even
+ * while a slow batch holds back the ones finished after it.
+ *
+ *     bool source(Input&);                      // false at end of input
+ *     void convert(Input const&, std::ostream&);
+ *     void sink(std::string const&);
+ */
+template <typename Input, typename Source, typename Convert, typename Sink>
+void
+ordered_pipeline(unsigned const threads, size_t const batch_size, Source source, Convert convert, Sink sink)
+{
+    if (threads <= 1) {
+        std::ostringstream os;
+        Input input;
+        while (source(input)) {
+            convert(input, os);
+            if (os.tellp() >= std::streamoff(1 << 16)) {
+                sink(os.str());
+                os.str(std::string());
+            }
+        }
+        sink(os.str());
+        return;
+    }
+
+    typedef std::pair<size_t, std::vector<Input>> batch;
+    typedef std::pair<size_t, std::string> result;
+    size_t const window = 2 * threads;
+    bounded_queue<batch> inputs(window);
+    bounded_queue<result> outputs(window);
+
+    // Batches before this one have all gone to sink.
+    std::mutex released_mutex;
+    std::condition_variable released_changed;
+    size_t released = 0;
+    auto const push = [&](batch item) {
+        {
+            std::unique_lock<std::mutex> lock(released_mutex);
+            released_changed.wait(lock, [&] { return item.first - released < window; });
+        }
+        inputs.push(std::move(item));
+    };
+
+    std::thread reader([&] {
+        size_t sequence = 0;
+        batch next(sequence, std::vector<Input>());
+        next.second.reserve(batch_size);
+        Input input;
+        while (source(input)) {
+            next.second.push_back(std::move(input));
+            if (next.second.size() == batch_size) {
+                push(std::move(next));
+                next = batch(++sequence, std::vector<Input>());
+                next.second.reserve(batch_size);
+            }
+        }
+        if (!next.second.empty())
+            push(std::move(next));
+        inputs.close();
+    });
+
+    std::vector<std::thread> workers;
+    std::mutex remaining_mutex;
+    unsigned remaining = threads;
+    for (unsigned i = 0; i < threads; ++i) {
+        workers.emplace_back([&] {
+            std::ostringstream os;
+            batch work;
+            while (inputs.pop(work)) {
+                os.str(std::string());
+                for (Input const& input: work.second)
+                    convert(input, os);
+                outputs.push(result(work.first, os.str()));
+            }
+            std::lock_guard<std::mutex> lock(remaining_mutex);
+            if (--remaining == 0)
+                outputs.close();
+        });
+    }
+
+    // Batches finish out of order; hold the early ones until their turn.
+    std::map<size_t, std::string> pending;
+    size_t next_sequence = 0;
+    result done;
+    while (outputs.pop(done)) {
+        pending.insert(std::move(done));
+        size_t const before = next_sequence;
+        for (auto it = pending.begin(); it != pending.end() && it->first == next_sequence; it = pending.erase(it)) {
+            sink(it->second);
+            ++next_sequence;
+        }
+        if (next_sequence != before) {
+            std::lock_guard<std::mutex> lock(released_mutex);
+            released = next_sequence;
+            released_changed.notify_one();
+        }
+    }
+
+    reader.join();
+    for (auto& worker: workers)
+        worker.join();
+}
+
+#endif
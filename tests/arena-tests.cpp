@@ -0,0 +1,83 @@
+#include "config.h"
+#include <cstdlib>
+#include <limits>
+#include <vector>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <boost/cstdfloat.hpp>
+#include <boost/multiprecision/cpp_int.hpp>
+#include "exact-float.h"
+#include "src/arena.h"
+
+using ::testing::Eq;
+using ::testing::Gt;
+
+namespace mp = boost::multiprecision;
+
+typedef mp::number<mp::cpp_int_backend<0, 0, mp::signed_magnitude, mp::unchecked, arena_allocator<mp::limb_type>>>
+    arena_int;
+
+TEST(Arena, uses_heap_outside_scope)
+{
+    arena_int const value = arena_int(1) << 1000;
+    EXPECT_THAT(arena::local().used(), Eq(0u));
+    EXPECT_TRUE(mp::bit_test(value, 1000));
+}
+
+TEST(Arena, releases_at_outermost_scope)
+{
+    {
+        arena_scope const outer;
+        arena_int const a = arena_int(1) << 1000;
+        size_t const used = arena::local().used();
+        {
+            arena_scope const inner;
+            arena_int const b = a * a;
+            EXPECT_THAT(mp::msb(b), Eq(2000u));
+        }
+        EXPECT_THAT(used, Gt(0u));
+        EXPECT_THAT(arena::local().used(), Eq(used));
+    }
+    EXPECT_THAT(arena::local().used(), Eq(0u));
+}
+
+TEST(Arena, grows_past_one_block)
+{
+    arena_scope const scope;
+    std::vector<arena_int> values;
+    for (int i = 0; i < 100; ++i)
+        values.push_back(arena_int(i) << 8000);
+    EXPECT_THAT(arena::local().used(), Gt(64u * 1024));
+    for (int i = 0; i < 100; ++i)
+        EXPECT_THAT(values[i] >> 8000, Eq(i));
+}
+
+TEST(Arena, heap_scope_outlives_arena)
+{
+    arena_int kept;
+    {
+        arena_scope const scope;
+        heap_scope const heap;
+        kept = arena_int(7) << 5000;
+        EXPECT_THAT(arena::local().used(), Eq(0u));
+    }
+    arena_scope const scope;
+    arena_int const overwrite = arena_int(1) << 5000;
+    EXPECT_THAT(kept >> 5000, Eq(7));
+    EXPECT_THAT(mp::msb(overwrite), Eq(5000u));
+}
+
+#ifdef BOOST_FLOAT80_C
+// The tables an Extended conversion caches are destroyed at exit, after the
+// thread's arena; freeing them mustn't touch it. Run under AddressSanitizer
+// to catch it if it does.
+TEST(Arena, statics_outlive_thread_arena)
+{
+    EXPECT_EXIT({
+        FloatInfo const info = exact(std::numeric_limits<boost::float80_t>::denorm_min());
+        std::vector<char> buffer(exact_length(info));
+        exact_to_chars(buffer.data(), buffer.data() + buffer.size(), info);
+        std::exit(EXIT_SUCCESS);
+    }, ::testing::ExitedWithCode(EXIT_SUCCESS), "");
+}
+#endif
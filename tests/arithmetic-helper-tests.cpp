@@ -1,6 +1,12 @@
 #include "config.h"
+#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
 #include <tuple>
+#include <vector>
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 #include <boost/utility/binary.hpp>
@@ -124,42 +130,172 @@ INSTANTIATE_TEST_CASE_P(ReduceCases,
                         TestReduceExponent,
                         ::testing::ValuesIn(reduce_cases));
 
+namespace {
+
+// 1234567890 as exact_to_chars writes it with grouping and comma separators
+std::string
+grouped(std::string const& grouping)
+{
+    exact_format format;
+    format.grouping = grouping;
+    format.thousands_sep = ',';
+    char buffer[64];
+    return std::string(buffer, exact_to_chars(buffer, buffer + sizeof buffer, 1234567890.0, format).ptr);
+}
+
+}
+
 TEST(Thousands, basic_separator)
 {
-    std::ostringstream os;
-    insert_thousands(os, "\3", ',', "1234567890");
-    EXPECT_THAT(os.str(), std::string("1,234,567,890"));
+    EXPECT_THAT(grouped("\3"), std::string("1,234,567,890"));
 }
 
 TEST(Thousands, varying_separator_distance)
 {
-    std::ostringstream os;
-    insert_thousands(os, "\1\2\3", ',', "1234567890");
-    EXPECT_THAT(os.str(), std::string("1,234,567,89,0"));
+    EXPECT_THAT(grouped("\1\2\3"), std::string("1,234,567,89,0"));
 }
 
 TEST(Thousands, zero_separator_means_unlimited)
 {
-    std::ostringstream os;
     std::string const separators("\3\0\3", 3);
-    insert_thousands(os, separators, ',', "1234567890");
-    EXPECT_THAT(os.str(), std::string("1234567,890"));
+    EXPECT_THAT(grouped(separators), std::string("1234567,890"));
 }
 
 TEST(Thousands, max_separator_means_unlimited)
 {
-    std::ostringstream os;
     std::string const separators("\2");
-    insert_thousands(os, separators + char(CHAR_MAX) + '\3', ',', "1234567890");
-    EXPECT_THAT(os.str(), std::string("12345678,90"));
+    EXPECT_THAT(grouped(separators + char(CHAR_MAX) + '\3'), std::string("12345678,90"));
 }
 
 #if CHAR_MIN < 0
 TEST(Thousands, negative_separator_means_unlimited)
 {
-    std::ostringstream os;
     std::string const separators("\2");
-    insert_thousands(os, separators + char(-1) + '\3', ',', "1234567890");
-    EXPECT_THAT(os.str(), std::string("12345678,90"));
+    EXPECT_THAT(grouped(separators + char(-1) + '\3'), std::string("12345678,90"));
+}
+#endif
+
+template <typename Float>
+class FixedWidthEngine: public ::testing::Test
+{
+};
+
+using FixedWidthTypes = ::testing::Types<boost::float32_t, boost::float64_t>;
+TYPED_TEST_CASE(FixedWidthEngine, FixedWidthTypes);
+
+TYPED_TEST(FixedWidthEngine, extremes_match_cpp_int)
+{
+    using limits = std::numeric_limits<TypeParam>;
+    // Largest finite value, and the smallest denormal.
+    std::tuple<mp::cpp_int, int> const extremes[] {
+        std::make_tuple((mp::cpp_int(1) << limits::digits) - 1, limits::max_exponent - limits::digits),
+        std::make_tuple(mp::cpp_int(1), limits::min_exponent - limits::digits),
+    };
+    for (auto const& extreme: extremes) {
+        std::string fixed(decimal_length(std::get<0>(extreme), std::get<1>(extreme), false, exact_format()), '\0');
+        std::string dynamic(fixed.size(), '\0');
+        fixed.resize(write_decimal<fixed_uint<TypeParam>>(&fixed[0], &fixed[0] + fixed.size(),
+                                                          std::get<0>(extreme), std::get<1>(extreme),
+                                                          false, exact_format()).ptr - fixed.data());
+        dynamic.resize(write_decimal<mp::cpp_int>(&dynamic[0], &dynamic[0] + dynamic.size(),
+                                                  std::get<0>(extreme), std::get<1>(extreme),
+                                                  false, exact_format()).ptr - dynamic.data());
+        EXPECT_THAT(fixed, Eq(dynamic));
+    }
+}
+
+TYPED_TEST(FixedWidthEngine, power_table_matches_pow)
+{
+    using limits = std::numeric_limits<TypeParam>;
+    unsigned const largest = limits::digits - limits::min_exponent;
+    for (unsigned n: {0u, 1u, 2u, 27u, largest / 2, largest}) {
+        EXPECT_THAT(mp::cpp_int(power_of_five<fixed_uint<TypeParam>>(n)), Eq(mp::pow(mp::cpp_int(5), n)));
+        EXPECT_THAT(power_of_five<mp::cpp_int>(n), Eq(mp::pow(mp::cpp_int(5), n)));
+    }
+}
+
+TEST(PowerOfFive, beyond_cached_squares)
+{
+    EXPECT_THAT(power_of_five<mp::cpp_int>(40000), Eq(mp::pow(mp::cpp_int(5), 40000)));
+}
+
+TEST(DecimalDigits, matches_str_across_split_levels)
+{
+    for (unsigned n: {0u, 1u, 19u, 20u, 600u, 3000u, 19000u}) {
+        mp::cpp_int const value = mp::pow(mp::cpp_int(7), n);
+        std::string digits(max_digits(value), '\0');
+        digits.resize(write_digits(value, &digits[0]) - digits.data());
+        EXPECT_THAT(digits, Eq(value.str()));
+    }
+}
+
+TEST(DecimalDigits, pads_with_leading_zeros)
+{
+    // The fraction of the smallest Extended denormal
+    unsigned const width = 16445;
+    mp::cpp_int const value = mp::pow(mp::cpp_int(5), width);
+    std::string digits(width, '\0');
+    write_padded_digits(value, width, &digits[0]);
+    std::string const expected = value.str();
+    EXPECT_THAT(digits, Eq(std::string(width - expected.size(), '0') + expected));
+}
+
+TEST(WriteChunk, pads_every_width)
+{
+    std::mt19937_64 random(16);
+    std::uint64_t limit = 1;
+    for (unsigned width = 1; width <= chunk_digits; ++width) {
+        limit *= 10;
+        for (std::uint64_t const value: {std::uint64_t(0), limit / 10, limit - 1, random() % limit}) {
+            char digits[chunk_digits + 1] = {};
+            char* const end = write_chunk(value, width, digits);
+            std::ostringstream expected;
+            expected << std::setw(width) << std::setfill('0') << value;
+            EXPECT_THAT(end - digits, Eq(width));
+            EXPECT_THAT(std::string(digits), Eq(expected.str())) << value;
+        }
+    }
+}
+
+TYPED_TEST(FixedWidthEngine, digits_match_str)
+{
+    fixed_uint<TypeParam> const value = ~fixed_uint<TypeParam>(0);
+    std::string digits(max_digits(value), '\0');
+    digits.resize(write_digits(value, &digits[0]) - digits.data());
+    EXPECT_THAT(digits, Eq(value.str()));
+}
+
+#ifdef USE_GMP
+// Built --with-gmp: GMP and cpp_int must produce the same digits across the
+// Extended range, on both sides of the size where write_extended switches.
+TEST(GmpEngine, matches_cpp_int)
+{
+    using limits = std::numeric_limits<boost::float80_t>;
+    std::vector<std::tuple<mp::cpp_int, int>> cases {
+        std::make_tuple(mp::cpp_int(0), 0),
+        std::make_tuple((mp::cpp_int(1) << limits::digits) - 1, limits::max_exponent - limits::digits),
+        std::make_tuple(mp::cpp_int(1), limits::min_exponent - limits::digits),
+    };
+    std::mt19937_64 random(20261017);
+    std::uniform_int_distribution<int> exponents(limits::min_exponent - limits::digits,
+                                                 limits::max_exponent - limits::digits);
+    for (int i = 0; i < 200; ++i)
+        cases.push_back(std::make_tuple(mp::cpp_int(random()), exponents(random)));
+
+    for (auto const& c: cases) {
+        mp::cpp_int const& value = std::get<0>(c);
+        int const bin_exp = std::get<1>(c);
+        std::string gmp(decimal_length(value, bin_exp, true, exact_format()), '\0');
+        std::string cpp(gmp.size(), '\0');
+        std::string chosen(gmp.size(), '\0');
+        gmp.resize(write_decimal<mp::mpz_int>(&gmp[0], &gmp[0] + gmp.size(), value, bin_exp,
+                                              true, exact_format()).ptr - gmp.data());
+        cpp.resize(write_decimal<mp::cpp_int>(&cpp[0], &cpp[0] + cpp.size(), value, bin_exp,
+                                              true, exact_format()).ptr - cpp.data());
+        chosen.resize(write_extended(&chosen[0], &chosen[0] + chosen.size(), value, bin_exp,
+                                     true, exact_format()).ptr - chosen.data());
+        EXPECT_THAT(gmp, Eq(cpp)) << value << " * 2^" << bin_exp;
+        EXPECT_THAT(chosen, Eq(cpp)) << value << " * 2^" << bin_exp;
+    }
 }
 #endif
@@ -1,6 +1,8 @@
 #include "config.h"
 #include <ostream>
+#include <cstdint>
 #include <ios>
+#include <stdexcept>
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 #include <boost/cstdfloat.hpp>
@@ -19,6 +21,17 @@ struct float_rec: public boost::static_visitor<mp::cpp_int>
     }
 };
 
+struct float_rec_into: public boost::static_visitor<void>
+{
+    mp::cpp_int& rec;
+    explicit float_rec_into(mp::cpp_int& rec): rec(rec) { }
+
+    template <typename Float>
+    void operator()(Float const value) const {
+        to_float_rec(value, rec);
+    }
+};
+
 using anyfloat = boost::variant<boost::float80_t, boost::float64_t, boost::float32_t>;
 
 struct ConversionCase
@@ -63,6 +76,51 @@ TEST_P(FloatToBits, test_convert)
     EXPECT_THAT(rec, GetParam().expectation);
 }
 
+TEST_P(FloatToBits, overwrites_existing_rec)
+{
+    mp::cpp_int rec = ~(mp::cpp_int(1) << 100);
+    boost::apply_visitor(float_rec_into(rec), GetParam().input);
+    EXPECT_THAT(rec, GetParam().expectation);
+}
+
 INSTANTIATE_TEST_CASE_P(FTB,
                         FloatToBits,
                         ::testing::ValuesIn(bit_conversions));
+
+static_assert(float_traits<boost::float64_t>::exponent_mask == 0x7ff, "double has 11 exponent bits");
+static_assert(float_traits<boost::float64_t>::mantissa_mask == 0xfffffffffffffu, "double stores 52 mantissa bits");
+static_assert(float_traits<boost::float32_t>::exponent_bias == 127, "float's bias is 127");
+#ifdef BOOST_FLOAT80_C
+static_assert(float_traits<boost::float80_t>::mantissa_mask == ~std::uint64_t(0), "x87 stores all 64 digits");
+#endif
+
+template <typename Float>
+class FloatDescriptor: public ::testing::Test
+{
+};
+
+using described_floats = ::testing::Types<
+#ifdef BOOST_FLOAT80_C
+    boost::float80_t,
+#endif
+#ifdef BOOST_FLOAT64_C
+    boost::float64_t,
+#endif
+    boost::float32_t>;
+TYPED_TEST_CASE(FloatDescriptor, described_floats);
+
+TYPED_TEST(FloatDescriptor, matches_traits)
+{
+    using traits = float_traits<TypeParam>;
+    float_descriptor const& descriptor = describe<TypeParam>();
+    EXPECT_THAT(descriptor.bits, traits::bits);
+    EXPECT_THAT(descriptor.mantissa_bits(), traits::mantissa_bits);
+    EXPECT_THAT(descriptor.exponent_bits(), traits::exponent_bits);
+    EXPECT_THAT(descriptor.exponent_bias(), traits::exponent_bias);
+    EXPECT_TRUE(kind_of(typeid(TypeParam)) == traits::kind);
+}
+
+TEST(FloatDescriptor, rejects_unknown_types)
+{
+    EXPECT_THROW(kind_of(typeid(int)), std::out_of_range);
+}
@@ -0,0 +1,128 @@
+#include "config.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <system_error>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <boost/cstdfloat.hpp>
+#include "decimal-parse.h"
+#include "exact-float.h"
+#include "float-literals.h"
+
+using ::testing::Eq;
+
+namespace {
+
+std::errc
+parse(std::string const& text, decimal_value& value)
+{
+    return value.parse(text.data(), text.data() + text.size());
+}
+
+template <typename Float>
+Float
+parse_as(std::string const& text)
+{
+    decimal_value value;
+    EXPECT_THAT(parse(text, value), Eq(std::errc())) << text;
+    Float result;
+    EXPECT_THAT(value.to(result), Eq(std::errc())) << text;
+    return result;
+}
+
+}
+
+class DecimalSyntax: public ::testing::TestWithParam<char const*>
+{
+};
+
+TEST_P(DecimalSyntax, rejects_malformed_input)
+{
+    decimal_value value;
+    EXPECT_THAT(parse(GetParam(), value), Eq(std::errc::invalid_argument));
+}
+
+INSTANTIATE_TEST_CASE_P(Malformed, DecimalSyntax, ::testing::Values(
+    "", "+", "-", ".", ".e5", "e5", "1e", "1e+", "1e+-5", "--1", " 1", "1 ", "1.5e3x", "1,5", "1..2", "0x10",
+    "1f", "infin", "infinityx", "nanq", "nan(1"));
+
+TEST(DecimalValue, accepts_what_lexical_cast_accepts)
+{
+    for (char const* const text: { "1", "+1", "-.5", "5.", "00012", "1E+5", "1.e5", "0.e0", "inf", "-Infinity",
+                                   "NaN", "nan(a_b9)", "nan()" }) {
+        decimal_value value;
+        EXPECT_THAT(parse(text, value), Eq(std::errc())) << text;
+    }
+}
+
+TEST(DecimalValue, keeps_signs_of_specials)
+{
+    EXPECT_THAT(parse_as<double>("-inf"), Eq(-std::numeric_limits<double>::infinity()));
+    EXPECT_TRUE(std::isnan(parse_as<double>("-nan")));
+    EXPECT_TRUE(std::signbit(parse_as<double>("-nan")));
+    EXPECT_TRUE(std::signbit(parse_as<double>("-0.0")));
+}
+
+#ifdef BOOST_FLOAT64_C
+TEST(DecimalValue, rounds_float64_half_to_even)
+{
+    EXPECT_THAT(parse_as<boost::float64_t>("0.1"), Eq(0x3fb999999999999a_float));
+    // Halfway between 2^53 and the next double
+    EXPECT_THAT(parse_as<boost::float64_t>("9007199254740993"), Eq(0x4340000000000000_float));
+    // A digit far past the 19th breaks the tie.
+    EXPECT_THAT(parse_as<boost::float64_t>("9007199254740993.0000000000000000000000000001"),
+                Eq(0x4340000000000001_float));
+    EXPECT_THAT(parse_as<boost::float64_t>("1.00000000000000011102230246251565404236316680908203125"),
+                Eq(0x3ff0000000000000_float));
+    EXPECT_THAT(parse_as<boost::float64_t>("1.00000000000000011102230246251565404236316680908203126"),
+                Eq(0x3ff0000000000001_float));
+}
+
+TEST(DecimalValue, rounds_float64_denormals)
+{
+    EXPECT_THAT(parse_as<boost::float64_t>("4.9406564584124654e-324"), Eq(0x0000000000000001_float));
+    EXPECT_THAT(parse_as<boost::float64_t>("2.4703282292062327e-324"), Eq(0x0000000000000000_float));
+    EXPECT_THAT(parse_as<boost::float64_t>("2.4703282292062328e-324"), Eq(0x0000000000000001_float));
+    EXPECT_THAT(parse_as<boost::float64_t>("2.2250738585072011e-308"), Eq(0x000fffffffffffff_float));
+    EXPECT_THAT(parse_as<boost::float64_t>("1e-400"), Eq(0x0000000000000000_float));
+}
+#endif
+
+#ifdef BOOST_FLOAT32_C
+TEST(DecimalValue, rounds_float32_half_to_even)
+{
+    EXPECT_THAT(parse_as<boost::float32_t>("0.1"), Eq(0x3dcccccd_float));
+    EXPECT_THAT(parse_as<boost::float32_t>("16777217"), Eq(0x4b800000_float));
+    EXPECT_THAT(parse_as<boost::float32_t>("33554435"), Eq(0x4c000001_float));
+    EXPECT_THAT(parse_as<boost::float32_t>("1.40129846e-45"), Eq(0x00000001_float));
+}
+#endif
+
+#ifdef BOOST_FLOAT80_C
+TEST(DecimalValue, rounds_float80)
+{
+    EXPECT_THAT(parse_as<boost::float80_t>("0.1"), Eq(0x3ffbcccccccccccccccd_float));
+    EXPECT_THAT(parse_as<boost::float80_t>("1e-4950"), Eq(0x00000000000000000003_float));
+    EXPECT_THAT(parse_as<boost::float80_t>("1.18973149535723176502e4932"), Eq(0x7ffeffffffffffffffff_float));
+}
+#endif
+
+#if defined(BOOST_FLOAT64_C) && defined(BOOST_FLOAT32_C)
+TEST(DecimalValue, reports_overflow_per_type)
+{
+    decimal_value value;
+    ASSERT_THAT(parse("1e39", value), Eq(std::errc()));
+    boost::float32_t single;
+    EXPECT_THAT(value.to(single), Eq(std::errc::result_out_of_range));
+    EXPECT_THAT(single, Eq(std::numeric_limits<boost::float32_t>::infinity()));
+    boost::float64_t double_;
+    EXPECT_THAT(value.to(double_), Eq(std::errc()));
+    EXPECT_THAT(double_, Eq(1e39));
+
+    ASSERT_THAT(parse("-1e400", value), Eq(std::errc()));
+    EXPECT_THAT(value.to(double_), Eq(std::errc::result_out_of_range));
+    EXPECT_THAT(double_, Eq(-std::numeric_limits<boost::float64_t>::infinity()));
+}
+#endif
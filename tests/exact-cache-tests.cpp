@@ -0,0 +1,121 @@
+#include "config.h"
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <boost/cstdfloat.hpp>
+#include "exact-cache.h"
+
+using ::testing::Eq;
+using ::testing::StrEq;
+
+namespace {
+
+template <typename Float>
+std::string
+uncached(Float const value, exact_format const& format = exact_format())
+{
+    std::vector<char> buffer(exact_length(value, format));
+    return std::string(buffer.data(), exact_to_chars(buffer.data(), buffer.data() + buffer.size(), value, format).ptr);
+}
+
+std::string
+cached(exact_cache& cache, FloatInfo const& info)
+{
+    std::ostringstream os;
+    cache.write(os, info);
+    return os.str();
+}
+
+}
+
+TEST(ExactCache, hits_after_first_conversion)
+{
+    exact_cache cache(16);
+    EXPECT_THAT(cached(cache, exact(0.1)), StrEq(uncached(0.1)));
+    EXPECT_THAT(cached(cache, exact(0.1)), StrEq(uncached(0.1)));
+    exact_cache_stats const stats = cache.stats();
+    EXPECT_THAT(stats.hits, Eq(1u));
+    EXPECT_THAT(stats.misses, Eq(1u));
+    EXPECT_THAT(stats.entries, Eq(1u));
+}
+
+TEST(ExactCache, tells_kinds_and_signs_apart)
+{
+    exact_cache cache(16);
+    EXPECT_THAT(cached(cache, exact(0.1f)), StrEq(uncached(0.1f)));
+    EXPECT_THAT(cached(cache, exact(0.1)), StrEq(uncached(0.1)));
+    EXPECT_THAT(cached(cache, exact(-0.1)), StrEq(uncached(-0.1)));
+    EXPECT_THAT(cached(cache, exact(0.0)), StrEq("0"));
+    EXPECT_THAT(cached(cache, exact(-0.0)), StrEq("-0"));
+    EXPECT_THAT(cache.stats().hits, Eq(0u));
+}
+
+TEST(ExactCache, drops_least_recently_used)
+{
+    exact_cache cache(2);
+    cached(cache, exact(1.5));
+    cached(cache, exact(2.5));
+    cached(cache, exact(1.5));
+    cached(cache, exact(3.5));
+    cached(cache, exact(1.5));
+    EXPECT_THAT(cache.stats().hits, Eq(2u));
+    cached(cache, exact(2.5));
+    EXPECT_THAT(cache.stats().misses, Eq(4u));
+    EXPECT_THAT(cache.stats().entries, Eq(2u));
+}
+
+TEST(ExactCache, applies_its_format)
+{
+    exact_format format;
+    format.showpos = true;
+    format.grouping = "\3";
+    exact_cache cache(4, format);
+    EXPECT_THAT(cached(cache, exact(1234567.25)), StrEq("+1,234,567.25"));
+    EXPECT_THAT(cached(cache, exact(1234567.25)), StrEq("+1,234,567.25"));
+}
+
+TEST(ExactCache, reports_short_buffer)
+{
+    exact_cache cache(4);
+    char buffer[4];
+    cached(cache, exact(0.125));
+    exact_to_chars_result const result = cache.to_chars(buffer, buffer + sizeof buffer, exact(0.125));
+    EXPECT_THAT(result.ec, Eq(std::errc::value_too_large));
+    EXPECT_THAT(result.ptr, Eq(buffer + sizeof buffer));
+}
+
+TEST(ExactCache, writes_long_values)
+{
+    boost::float80_t const tiny = std::numeric_limits<boost::float80_t>::denorm_min();
+    exact_cache cache(4);
+    EXPECT_THAT(cached(cache, exact(tiny)), StrEq(uncached(tiny)));
+    EXPECT_THAT(cached(cache, exact(tiny)), StrEq(uncached(tiny)));
+    EXPECT_THAT(cache.stats().hits, Eq(1u));
+}
+
+TEST(ExactCache, shared_across_threads)
+{
+    exact_cache cache(100);
+    unsigned const threads = 4;
+    unsigned const rounds = 50;
+    std::vector<std::thread> workers;
+    std::vector<int> failures(threads);
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&cache, &failures, t] {
+            for (unsigned round = 0; round < rounds; ++round)
+                for (int i = 0; i < 100; ++i)
+                    if (cached(cache, exact(i / 10.0)) != uncached(i / 10.0))
+                        ++failures[t];
+        });
+    }
+    for (std::thread& worker: workers)
+        worker.join();
+    EXPECT_THAT(failures, Eq(std::vector<int>(threads)));
+    exact_cache_stats const stats = cache.stats();
+    EXPECT_THAT(stats.hits + stats.misses, Eq(threads * rounds * 100));
+    EXPECT_THAT(stats.entries, Eq(100u));
+}
@@ -0,0 +1,92 @@
+#include "config.h"
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <boost/cstdfloat.hpp>
+#include "float-classify.h"
+
+using ::testing::ElementsAreArray;
+using ::testing::Eq;
+
+// Random bit patterns, weighted toward the edges of the exponent range and
+// the top mantissa bits so every class shows up
+template <typename Float, typename Word>
+std::vector<Float>
+sample_values(size_t const count)
+{
+    using traits = float_traits<Float>;
+    std::mt19937_64 random(traits::bits);
+    std::vector<Float> values(count);
+    for (auto& value: values) {
+        Word word = random();
+        switch (random() % 4) {
+            case 0:
+                word &= ~(Word(traits::exponent_mask) << traits::mantissa_bits);
+                break;
+            case 1:
+                word |= Word(traits::exponent_mask) << traits::mantissa_bits;
+                break;
+        }
+        if (random() % 3 == 0)
+            word &= ~Word(traits::mantissa_mask) | Word(random() % 2) << (traits::mantissa_bits - 1);
+        std::memcpy(&value, &word, sizeof value);
+    }
+    return values;
+}
+
+template <typename Float>
+void
+expect_matches_float_info(std::vector<Float> const& values, simd_level const level)
+{
+    float_columns columns;
+    classify_floats(values.data(), values.size(), columns, level);
+    ASSERT_THAT(columns.type.size(), Eq(values.size()));
+    std::array<size_t, signaling_nan + 1> histogram {};
+    for (size_t i = 0; i < values.size(); ++i) {
+        FloatInfo const info(values[i]);
+        EXPECT_THAT(columns.negative[i], Eq(std::signbit(values[i]))) << i;
+        EXPECT_THAT(columns.exponent[i], Eq(std::uint32_t(info.exponent))) << i;
+        EXPECT_THAT(columns.mantissa[i], Eq(info.mantissa)) << i;
+        EXPECT_THAT(columns.type[i], Eq(info.number_type)) << i;
+        ++histogram[info.number_type];
+    }
+    EXPECT_THAT(columns.histogram, ElementsAreArray(histogram));
+}
+
+class ClassifyFloats: public ::testing::TestWithParam<simd_level>
+{
+};
+
+TEST_P(ClassifyFloats, single_matches_float_info)
+{
+    // An odd count leaves a tail for the scalar loop.
+    expect_matches_float_info(sample_values<boost::float32_t, std::uint32_t>(1001), GetParam());
+}
+
+TEST_P(ClassifyFloats, double_matches_float_info)
+{
+    expect_matches_float_info(sample_values<boost::float64_t, std::uint64_t>(1001), GetParam());
+}
+
+TEST_P(ClassifyFloats, reuses_columns)
+{
+    float_columns columns;
+    std::vector<boost::float64_t> const many(100, 1.0);
+    boost::float64_t const few[] { 0.0, -0.0 };
+    classify_floats(many.data(), many.size(), columns, GetParam());
+    classify_floats(few, 2, columns, GetParam());
+    EXPECT_THAT(columns.type.size(), Eq(2u));
+    EXPECT_THAT(columns.histogram[zero], Eq(2u));
+    EXPECT_THAT(columns.histogram[normal], Eq(0u));
+    EXPECT_THAT(columns.negative[1], Eq(1u));
+}
+
+// Levels the processor lacks fall back to ones it has, so every level is
+// safe to request.
+INSTANTIATE_TEST_CASE_P(Levels, ClassifyFloats,
+                        ::testing::Values(simd_level::scalar, simd_level::sse2, simd_level::avx2));
@@ -0,0 +1,111 @@
+#include "config.h"
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <boost/cstdfloat.hpp>
+#include "src/mapped-file.h"
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/stat.h>
+#endif
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+
+// Writes bytes to a scratch file and removes it afterward
+class MappedFile: public ::testing::Test
+{
+protected:
+    std::string const name = "mapped-file-test.bin";
+
+    void write(char const* const bytes, size_t const size) {
+        std::ofstream(name, std::ios::binary).write(bytes, size);
+    }
+
+    void TearDown() override {
+        std::remove(name.c_str());
+    }
+};
+
+TEST_F(MappedFile, reads_whole_file)
+{
+    write("abc\0def", 7);
+    mapped_file const file(name);
+    ASSERT_THAT(file.size(), Eq(7u));
+    EXPECT_THAT(std::string(file.data(), file.size()), Eq(std::string("abc\0def", 7)));
+}
+
+TEST_F(MappedFile, allows_empty_file)
+{
+    write("", 0);
+    mapped_file const file(name);
+    EXPECT_THAT(file.size(), Eq(0u));
+}
+
+#ifdef HAVE_SYS_MMAN_H
+TEST_F(MappedFile, reads_pipe)
+{
+    ASSERT_THAT(::mkfifo(name.c_str(), 0600), Eq(0));
+    std::string const contents(100000, 'x');
+    std::thread writer([&] {
+        std::ofstream(name, std::ios::binary) << contents;
+    });
+    mapped_file const file(name);
+    writer.join();
+    EXPECT_THAT(std::string(file.data(), file.size()), Eq(contents));
+}
+
+TEST_F(MappedFile, reads_empty_pipe)
+{
+    ASSERT_THAT(::mkfifo(name.c_str(), 0600), Eq(0));
+    std::thread writer([&] {
+        std::ofstream(name, std::ios::binary);
+    });
+    mapped_file const file(name);
+    writer.join();
+    EXPECT_THAT(file.size(), Eq(0u));
+}
+#endif
+
+TEST_F(MappedFile, reports_missing_file)
+{
+    EXPECT_THROW(mapped_file("no-such-file.bin"), std::system_error);
+}
+
+#ifdef BOOST_FLOAT64_C
+TEST_F(MappedFile, reads_struct_members)
+{
+    // A 4-byte header, then records of a tag and a double, packed
+    std::vector<char> bytes(4);
+    for (boost::float64_t const value: { 1.5, -2.0, 0.25 }) {
+        bytes.push_back('t');
+        char const* const first = reinterpret_cast<char const*>(&value);
+        bytes.insert(bytes.end(), first, first + sizeof value);
+    }
+    // A partial record at the end doesn't count.
+    bytes.insert(bytes.end(), 3, 'x');
+    write(bytes.data(), bytes.size());
+
+    mapped_file const file(name);
+    record_layout const layout { 5, 9, 8 };
+    ASSERT_THAT(layout.count(file.size()), Eq(3u));
+    std::vector<boost::float64_t> values(3);
+    read_records(file.data(), layout, 0, 3, values.data());
+    EXPECT_THAT(values, ElementsAre(1.5, -2.0, 0.25));
+}
+#endif
+
+TEST(RecordLayout, counts_whole_values)
+{
+    record_layout const layout { 2, 16, 10 };
+    EXPECT_THAT(layout.count(0), Eq(0u));
+    EXPECT_THAT(layout.count(11), Eq(0u));
+    EXPECT_THAT(layout.count(12), Eq(1u));
+    EXPECT_THAT(layout.count(27), Eq(1u));
+    EXPECT_THAT(layout.count(28), Eq(2u));
+}
@@ -0,0 +1,97 @@
+#include "config.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include "src/pipeline.h"
+
+using ::testing::Eq;
+using ::testing::Le;
+using ::testing::StrEq;
+
+class OrderedPipeline: public ::testing::TestWithParam<unsigned>
+{
+};
+
+TEST_P(OrderedPipeline, keeps_input_order)
+{
+    int next = 0;
+    std::string output;
+    ordered_pipeline<int>(GetParam(), 7,
+        [&](int& value) {
+            value = next++;
+            return value < 1000;
+        },
+        [](int const value, std::ostream& os) {
+            // Give later batches a chance to finish first.
+            if (value % 97 == 0)
+                std::this_thread::yield();
+            os << value << '\n';
+        },
+        [&](std::string const& text) {
+            output += text;
+        });
+
+    std::string expected;
+    for (int i = 0; i < 1000; ++i)
+        expected += std::to_string(i) + '\n';
+    EXPECT_THAT(output, StrEq(expected));
+}
+
+TEST_P(OrderedPipeline, handles_empty_input)
+{
+    std::string output;
+    ordered_pipeline<int>(GetParam(), 7,
+        [](int&) { return false; },
+        [](int const value, std::ostream& os) { os << value; },
+        [&](std::string const& text) { output += text; });
+    EXPECT_THAT(output, StrEq(""));
+}
+
+TEST_P(OrderedPipeline, stays_close_behind_slow_batch)
+{
+    std::atomic<int> next(0);
+    int read_while_stuck = 0;
+    std::string output;
+    ordered_pipeline<int>(GetParam(), 7,
+        [&](int& value) {
+            value = next++;
+            return value < 1000;
+        },
+        [&](int const value, std::ostream& os) {
+            if (value == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                read_while_stuck = next;
+            }
+            os << value << '\n';
+        },
+        [&](std::string const& text) {
+            output += text;
+        });
+
+    // The batches in the window, plus the one the reader is filling
+    EXPECT_THAT(read_while_stuck, Le(int((2 * GetParam() + 1) * 7)));
+    EXPECT_THAT(std::count(output.begin(), output.end(), '\n'), Eq(1000));
+}
+
+INSTANTIATE_TEST_CASE_P(ThreadCounts, OrderedPipeline,
+                        ::testing::Values(1u, 2u, 8u));
+
+TEST(BoundedQueue, drains_after_close)
+{
+    bounded_queue<int> queue(2);
+    queue.push(1);
+    queue.push(2);
+    queue.close();
+    int value;
+    ASSERT_TRUE(queue.pop(value));
+    EXPECT_THAT(value, Eq(1));
+    ASSERT_TRUE(queue.pop(value));
+    EXPECT_THAT(value, Eq(2));
+    EXPECT_FALSE(queue.pop(value));
+}
@@ -1,11 +1,15 @@
 #include "config.h"
 #include <cmath>
+#include <iomanip>
 #include <ios>
 #include <iostream>
 #include <array>
+#include <iterator>
 #include <limits>
 #include <locale>
+#include <sstream>
 #include <typeindex>
+#include <vector>
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 #include <boost/utility/binary.hpp>
@@ -15,7 +19,9 @@
 #include "float-literals.h"
 #include "exact-float.h"
 
+using ::testing::ElementsAre;
 using ::testing::Eq;
+using ::testing::Ge;
 using ::testing::StrEq;
 using ::testing::_;
 using ::testing::ResultOf;
@@ -429,6 +435,38 @@ TEST_F(Serialization, honor_alternative_separator)
                 ResultOf(str, StrEq("1j23j45j67")));
 }
 
+TEST_F(Serialization, asks_facet_once_per_locale)
+{
+    NiceMock<MockNumpunct> facet;
+    ON_CALL(facet, do_grouping())
+        .WillByDefault(Return("\3"));
+    os.imbue(std::locale(os.getloc(), &facet));
+    os << FloatInfo(1234567.0);
+    ON_CALL(facet, do_grouping())
+        .WillByDefault(Return("\2"));
+    os << ' ' << FloatInfo(1234567.0);
+    os.imbue(std::locale(std::locale::classic(), &facet));
+    os << ' ' << FloatInfo(1234567.0);
+    EXPECT_THAT(os.str(), StrEq("1,234,567 1,234,567 1,23,45,67"));
+}
+
+TEST_F(Serialization, copies_locale_with_format)
+{
+    NiceMock<MockNumpunct> facet;
+    ON_CALL(facet, do_grouping())
+        .WillByDefault(Return("\3"));
+    std::ostringstream grouped;
+    grouped.imbue(std::locale(grouped.getloc(), &facet));
+    grouped << FloatInfo(1000.0);
+    os << FloatInfo(1000.0);
+    os.copyfmt(grouped);
+    os << ' ' << FloatInfo(1000.0);
+    grouped.imbue(std::locale::classic());
+    grouped << ' ' << FloatInfo(1000.0);
+    EXPECT_THAT(os.str(), StrEq("1000 1,000"));
+    EXPECT_THAT(grouped.str(), StrEq("1,000 1000"));
+}
+
 TEST_F(Serialization, no_separator_in_fraction)
 {
     NiceMock<MockNumpunct> facet;
@@ -439,3 +477,305 @@ TEST_F(Serialization, no_separator_in_fraction)
     EXPECT_THAT(os << value,
                 ResultOf(str, StrEq("0.0625")));
 }
+
+TEST_F(Serialization, smallest_single_denormal)
+{
+    FloatInfo const value{std::numeric_limits<boost::float32_t>::denorm_min()};
+    EXPECT_THAT(os << value,
+                ResultOf(str, StrEq("0.00000" "00000" "00000" "00000" "00000" "00000" "00000" "00000" "00001" "40129"
+                                    "84643" "24817" "07092" "37295" "83289" "91613" "12802" "61941" "87651" "57717"
+                                    "57068" "28388" "97910" "82685" "86060" "14866" "38188" "36212" "15820" "3125")));
+}
+
+TEST_F(Serialization, smallest_double_denormal)
+{
+    FloatInfo const value{std::numeric_limits<boost::float64_t>::denorm_min()};
+    std::string const digits = mp::cpp_int(mp::pow(mp::cpp_int(5), 1074)).str();
+    EXPECT_THAT(os << value,
+                ResultOf(str, StrEq("0." + std::string(1074 - digits.size(), '0') + digits)));
+}
+
+TEST_F(Serialization, rounds_fixed_to_precision)
+{
+    FloatInfo const value { 0.1 };
+    EXPECT_THAT(os << std::fixed << std::setprecision(20) << value,
+                ResultOf(str, StrEq("0.10000000000000000555")));
+}
+
+TEST_F(Serialization, fixed_rounds_half_to_even)
+{
+    EXPECT_THAT(os << std::fixed << std::setprecision(0) << FloatInfo(2.5) << ' ' << FloatInfo(3.5),
+                ResultOf(str, StrEq("2 4")));
+}
+
+TEST_F(Serialization, rounds_scientific_to_precision)
+{
+    FloatInfo const value { 99999.5 };
+    EXPECT_THAT(os << std::scientific << std::setprecision(3) << value,
+                ResultOf(str, StrEq("1.000e+05")));
+}
+
+TEST_F(Serialization, scientific_honors_uppercase_and_showpos)
+{
+    FloatInfo const value{std::numeric_limits<boost::float64_t>::denorm_min()};
+    EXPECT_THAT(os << std::scientific << std::uppercase << std::showpos << std::setprecision(2) << value,
+                ResultOf(str, StrEq("+4.94E-324")));
+}
+
+TEST(ExactToChars, rounds_to_explicit_precision)
+{
+    char buffer[64];
+    exact_format const format(exact_notation::scientific, 39);
+    auto const result = exact_to_chars(std::begin(buffer), std::end(buffer),
+                                       std::numeric_limits<boost::float32_t>::denorm_min(), format);
+    EXPECT_THAT(std::string(buffer, result.ptr), StrEq("1.401298464324817070923729583289916131280e-45"));
+    EXPECT_THAT(exact_length(std::numeric_limits<boost::float32_t>::denorm_min(), format),
+                Eq(size_t(result.ptr - buffer)));
+}
+
+TEST(ExactToChars, writes_plain_digits)
+{
+    char buffer[16];
+    auto const result = exact_to_chars(std::begin(buffer), std::end(buffer), 1234.5);
+    EXPECT_THAT(result.ec, Eq(std::errc()));
+    EXPECT_THAT(std::string(buffer, result.ptr), StrEq("1234.5"));
+}
+
+TEST(ExactToChars, signs_negative_only)
+{
+    char buffer[16];
+    auto const negative = exact_to_chars(std::begin(buffer), std::end(buffer), -0.5f);
+    EXPECT_THAT(std::string(buffer, negative.ptr), StrEq("-0.5"));
+    auto const positive = exact_to_chars(std::begin(buffer), std::end(buffer), 0.5f);
+    EXPECT_THAT(std::string(buffer, positive.ptr), StrEq("0.5"));
+}
+
+TEST(ExactToChars, fills_exact_buffer)
+{
+    char buffer[4];
+    auto const result = exact_to_chars(std::begin(buffer), std::end(buffer), -1.5);
+    EXPECT_THAT(result.ec, Eq(std::errc()));
+    EXPECT_THAT(result.ptr, Eq(std::end(buffer)));
+}
+
+TEST(ExactToChars, reports_small_buffer)
+{
+    char buffer[3];
+    auto const result = exact_to_chars(std::begin(buffer), std::end(buffer), -1.5);
+    EXPECT_THAT(result.ec, Eq(std::errc::value_too_large));
+    EXPECT_THAT(result.ptr, Eq(std::end(buffer)));
+}
+
+TEST(ExactToChars, applies_format)
+{
+    exact_format format;
+    format.decimal_point = ':';
+    format.thousands_sep = '_';
+    format.grouping = "\3";
+    format.showpos = true;
+    char buffer[32];
+    auto const result = exact_to_chars(std::begin(buffer), std::end(buffer), 1234567.25, format);
+    EXPECT_THAT(std::string(buffer, result.ptr), StrEq("+1_234_567:25"));
+}
+
+TEST(ExactToChars, writes_special_values)
+{
+    char buffer[32];
+    auto const result = exact_to_chars(std::begin(buffer), std::end(buffer),
+                                       -std::numeric_limits<double>::infinity());
+    EXPECT_THAT(std::string(buffer, result.ptr), StrEq("- Infinity"));
+}
+
+struct exact_length_matches_output: public boost::static_visitor<void>
+{
+    exact_format const& format;
+    explicit exact_length_matches_output(exact_format const& format): format(format) { }
+
+    template <typename Float>
+    void operator()(Float const value) const {
+        std::vector<char> buffer(20000);
+        auto const result = exact_to_chars(buffer.data(), buffer.data() + buffer.size(), value, format);
+        EXPECT_THAT(exact_length(value, format), Eq(size_t(result.ptr - buffer.data()))) << value;
+    }
+};
+
+class ExactLength: public ::testing::TestWithParam<anyfloat>
+{
+};
+
+TEST_P(ExactLength, plain)
+{
+    boost::apply_visitor(exact_length_matches_output(exact_format()), GetParam());
+}
+
+TEST_P(ExactLength, grouped_with_sign_and_point)
+{
+    exact_format format;
+    format.grouping = "\1\2";
+    format.showpos = true;
+    format.showpoint = true;
+    boost::apply_visitor(exact_length_matches_output(format), GetParam());
+}
+
+anyfloat const length_cases[] {
+#ifdef BOOST_FLOAT80_C
+    BOOST_FLOAT80_C(0.), BOOST_FLOAT80_C(1.), BOOST_FLOAT80_C(10.), BOOST_FLOAT80_C(1e19), BOOST_FLOAT80_C(0.1),
+    std::numeric_limits<boost::float80_t>::max(), std::numeric_limits<boost::float80_t>::denorm_min(),
+    0x7fffc000000000000001_float,
+#endif
+#ifdef BOOST_FLOAT64_C
+    BOOST_FLOAT64_C(0.), BOOST_FLOAT64_C(-1.), BOOST_FLOAT64_C(1e22), BOOST_FLOAT64_C(1e23), BOOST_FLOAT64_C(999.999),
+    BOOST_FLOAT64_C(0.5), BOOST_FLOAT64_C(1024.), std::numeric_limits<boost::float64_t>::max(),
+    std::numeric_limits<boost::float64_t>::denorm_min(), std::numeric_limits<boost::float64_t>::infinity(),
+#endif
+#ifdef BOOST_FLOAT32_C
+    BOOST_FLOAT32_C(0.), BOOST_FLOAT32_C(100.), BOOST_FLOAT32_C(87.285), BOOST_FLOAT32_C(-1e10),
+    std::numeric_limits<boost::float32_t>::max(), std::numeric_limits<boost::float32_t>::denorm_min(),
+    0x7f800001_float,
+#endif
+};
+
+INSTANTIATE_TEST_CASE_P(LengthCases, ExactLength,
+                        ::testing::ValuesIn(length_cases));
+
+struct exact_digits_match_output: public boost::static_visitor<void>
+{
+    template <typename Float>
+    void operator()(Float const value) const {
+        std::vector<char> buffer(20000);
+        auto const result = exact_to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+        exact_digits digits(value);
+        EXPECT_THAT(std::string(digits.begin(), digits.end()), StrEq(std::string(buffer.data(), result.ptr)));
+    }
+};
+
+class ExactDigits: public ::testing::TestWithParam<anyfloat>
+{
+};
+
+TEST_P(ExactDigits, matches_exact_to_chars)
+{
+    boost::apply_visitor(exact_digits_match_output(), GetParam());
+}
+
+INSTANTIATE_TEST_CASE_P(LengthCases, ExactDigits,
+                        ::testing::ValuesIn(length_cases));
+
+TEST(ExactDigits, stops_early)
+{
+    exact_digits digits(std::numeric_limits<double>::denorm_min());
+    std::string prefix;
+    for (char c: digits) {
+        prefix += c;
+        if (prefix.size() == 40)
+            break;
+    }
+    EXPECT_THAT(prefix, StrEq("0.00000000000000000000000000000000000000"));
+}
+
+TEST(ExactDigits, spans_whole_chunks)
+{
+    exact_digits digits(-1e20);
+    char const* first;
+    char const* last;
+    std::vector<std::string> chunks;
+    while (digits.next(first, last))
+        chunks.emplace_back(first, last);
+    EXPECT_THAT(chunks, ElementsAre("-", "10000", "0000000000000000"));
+}
+
+template <typename Float>
+std::string
+exact_string(Float const value, exact_format const& format = exact_format())
+{
+    std::vector<char> buffer(exact_length(value, format));
+    return std::string(buffer.data(), exact_to_chars(buffer.data(), buffer.data() + buffer.size(), value, format).ptr);
+}
+
+TEST(ExactBatch, matches_exact_to_chars_for_each_value)
+{
+    std::vector<boost::float64_t> const values {
+        0., -1., 0.1, 1e23, std::numeric_limits<boost::float64_t>::max(),
+        std::numeric_limits<boost::float64_t>::denorm_min(), std::numeric_limits<boost::float64_t>::infinity(),
+        std::numeric_limits<boost::float64_t>::quiet_NaN(), 87.285,
+    };
+    exact_batch_result const result = exact_batch(values);
+    ASSERT_THAT(result.size(), Eq(values.size()));
+    for (size_t i = 0; i < values.size(); ++i)
+        EXPECT_THAT(result[i], StrEq(exact_string(values[i]))) << i;
+    EXPECT_THAT(result.offsets.back(), Eq(result.text.size()));
+}
+
+TEST(ExactBatch, applies_format)
+{
+    boost::float32_t const values[] { 1234.5f, -0.25f };
+    exact_format format;
+    format.grouping = "\3";
+    format.showpos = true;
+    exact_batch_result const result = exact_batch(values, 2, format);
+    EXPECT_THAT(result.text, StrEq("+1,234.5-0.25"));
+}
+
+TEST(ExactBatch, reuses_result)
+{
+    boost::float80_t const large[] { std::numeric_limits<boost::float80_t>::denorm_min(), 1 };
+    boost::float80_t const small[] { 2 };
+    exact_batch_result result;
+    exact_batch(large, 2, result);
+    EXPECT_THAT(result[1], StrEq("1"));
+    exact_batch(small, 1, result);
+    ASSERT_THAT(result.size(), Eq(1u));
+    EXPECT_THAT(result.text, StrEq("2"));
+}
+
+TEST(ExactStats, count_only_while_enabled)
+{
+    reset_exact_stats();
+    boost::float64_t const values[] { 0.5, 3., 0. };
+    exact_batch(values, 3);
+    EXPECT_THAT(get_exact_stats().conversions[unsigned(float_kind::float64)][normal], Eq(0u));
+
+    enable_exact_stats(true);
+    exact_batch_result const result = exact_batch(values, 3);
+    std::ostringstream os;
+    os << exact(1.5f);
+    enable_exact_stats(false);
+    exact_batch(values, 3);
+
+    exact_stats const stats = get_exact_stats();
+    EXPECT_THAT(stats.conversions[unsigned(float_kind::float64)][normal], Eq(2u));
+    EXPECT_THAT(stats.conversions[unsigned(float_kind::float64)][zero], Eq(1u));
+    EXPECT_THAT(stats.conversions[unsigned(float_kind::float32)][normal], Eq(1u));
+    EXPECT_THAT(stats.output_bytes, Eq(result.text.size() + 3));
+    EXPECT_THAT(stats.peak_limbs, Ge(1u));
+    reset_exact_stats();
+    EXPECT_THAT(get_exact_stats().output_bytes, Eq(0u));
+}
+
+TEST(FloatInfoValue, assigns_across_kinds)
+{
+    std::vector<FloatInfo> values(2);
+    values[0] = FloatInfo(1.5f);
+    values[1] = values[0];
+    values[0] = FloatInfo(-std::numeric_limits<boost::float64_t>::denorm_min());
+    EXPECT_THAT(exact_string(values[1]), StrEq("1.5"));
+    EXPECT_THAT(values[0].kind, Eq(float_kind::float64));
+    EXPECT_THAT(values[0].number_type, Eq(denormal));
+    EXPECT_THAT(values[0].mantissa, Eq(1u));
+}
+
+TEST(FloatInfoValue, keeps_sign_of_negative_zero)
+{
+    EXPECT_TRUE(FloatInfo(-0.0f).negative);
+    EXPECT_THAT(exact_string(-0.0), StrEq("-0"));
+    EXPECT_THAT(exact_string(BOOST_FLOAT80_C(-0.)), StrEq("-0"));
+}
+
+TEST(FloatInfoValue, reads_extended_fields)
+{
+    FloatInfo const info(BOOST_FLOAT80_C(-3.));
+    EXPECT_TRUE(info.negative);
+    EXPECT_THAT(info.exponent, Eq(0x4000));
+    EXPECT_THAT(info.mantissa, Eq(0xc000000000000000u));
+    EXPECT_THAT(info.number_type, Eq(normal));
+}